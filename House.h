@@ -4,19 +4,32 @@
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <iostream>
+#include "gl_handles.h"
 #include "shader.h"
 #include "stb_image.h"
 
 class House {
 public:
-    unsigned int VAO_walls, VBO_walls, VAO_roof, VBO_roof;
-    unsigned int textureWalls, textureRoof;
+    GlVertexArray VAO_walls, VAO_roof;
+    GlBuffer VBO_walls, VBO_roof;
+    GlTexture textureWalls, textureRoof;
 
     House(const char* wallTexPath, const char* roofTexPath) {
         setupWalls();
         setupRoof();
-        loadTexture(wallTexPath, textureWalls);
-        loadTexture(roofTexPath, textureRoof);
+        loadTexture(wallTexPath, textureWalls, "House walls");
+        loadTexture(roofTexPath, textureRoof, "House roof");
+    }
+
+    // call while the context is still current
+    void release() {
+        VAO_walls.reset();
+        VBO_walls.reset();
+        VAO_roof.reset();
+        VBO_roof.reset();
+        textureWalls.reset();
+        textureRoof.reset();
     }
 
     void Draw(Shader& shader, glm::mat4 view, glm::mat4 projection) {
@@ -81,11 +94,12 @@ private:
              -1.0f,0.0f, 1.0f,    0.0f,1.0f,
              -1.0f,0.0f,-1.0f,    0.0f,0.0f,
         };
-        glGenVertexArrays(1, &VAO_walls);
-        glGenBuffers(1, &VBO_walls);
+        VAO_walls.create("House walls");
+        VBO_walls.create("House walls");
         glBindVertexArray(VAO_walls);
         glBindBuffer(GL_ARRAY_BUFFER, VBO_walls);
         glBufferData(GL_ARRAY_BUFFER, sizeof(wallVertices), wallVertices, GL_STATIC_DRAW);
+        VBO_walls.setBytes(sizeof(wallVertices));
         glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
         glEnableVertexAttribArray(0);
         glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
@@ -118,11 +132,12 @@ private:
                0.0f,1.6f, 1.0f,    0.0f,1.0f,
                1.0f,1.0f, 1.0f,    0.0f,0.0f
         };
-        glGenVertexArrays(1, &VAO_roof);
-        glGenBuffers(1, &VBO_roof);
+        VAO_roof.create("House roof");
+        VBO_roof.create("House roof");
         glBindVertexArray(VAO_roof);
         glBindBuffer(GL_ARRAY_BUFFER, VBO_roof);
         glBufferData(GL_ARRAY_BUFFER, sizeof(roofVertices), roofVertices, GL_STATIC_DRAW);
+        VBO_roof.setBytes(sizeof(roofVertices));
         glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
         glEnableVertexAttribArray(0);
         glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
@@ -130,13 +145,18 @@ private:
         glBindVertexArray(0);
     }
 
-    void loadTexture(const char* path, GLuint& texID) {
+    void loadTexture(const char* path, GlTexture& texID, const char* site) {
         int w, h, c;
         stbi_set_flip_vertically_on_load(true);
         unsigned char* data = stbi_load(path, &w, &h, &c, 0);
-        glGenTextures(1, &texID);
+        if (!data) {
+            std::cerr << "Failed to load texture at path: " << path << "\n";
+            return;
+        }
+        texID.create(site);
         glBindTexture(GL_TEXTURE_2D, texID);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, w, h, 0, (c == 4 ? GL_RGBA : GL_RGB), GL_UNSIGNED_BYTE, data);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, w, h, 0, glComponentFormat(c), GL_UNSIGNED_BYTE, data);
+        texID.setBytes(glImageBytes(GL_RGBA, w, h, 1, true));
         glGenerateMipmap(GL_TEXTURE_2D);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
@@ -0,0 +1,244 @@
+#include "alloc_tracker.h"
+#include <cstdio>
+
+#if SMOKE_ALLOC_TRACKING
+#include <atomic>
+#include <climits>
+#include <cstdlib>
+#include <new>
+#if defined(__GLIBC__)
+#include <execinfo.h>
+#endif
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+namespace {
+
+// every field is constant-initialized, so allocations made before main() can be counted
+struct ThreadSlot {
+    std::atomic<uint64_t> allocations{ 0 }, bytes{ 0 }, frees{ 0 };
+    std::atomic<const char*> name{ nullptr };
+    AllocCounts frameStart, lastFrame; // beginFrame()'s thread only
+};
+
+ThreadSlot slots[AllocTracker::MAX_THREADS];
+std::atomic<int> slotsUsed{ 0 };
+std::atomic<long long> currentFrame{ -1 };
+std::atomic<long long> steadyFrom{ LLONG_MAX };
+std::atomic<bool> steady{ false };
+std::atomic<int> steadyPolicy{ (int)AllocPolicy::Log };
+std::atomic<uint64_t> steadyCount{ 0 };
+const uint64_t LOGGED_STACKS = 8;
+
+thread_local ThreadSlot* mySlot = nullptr;
+thread_local bool logging = false; // no recursion while a steady-state allocation is reported
+
+ThreadSlot& threadSlot() {
+    if (!mySlot) {
+        int i = slotsUsed.fetch_add(1, std::memory_order_relaxed);
+        mySlot = &slots[i < AllocTracker::MAX_THREADS ? i : AllocTracker::MAX_THREADS - 1];
+    }
+    return *mySlot;
+}
+
+AllocCounts read(const ThreadSlot& s) {
+    AllocCounts c;
+    c.allocations = s.allocations.load(std::memory_order_relaxed);
+    c.bytes = s.bytes.load(std::memory_order_relaxed);
+    c.frees = s.frees.load(std::memory_order_relaxed);
+    return c;
+}
+
+void printStack() {
+#if defined(__GLIBC__)
+    // backtrace_symbols_fd() writes straight to the fd, without allocating
+    void* frames[32];
+    int n = backtrace(frames, 32);
+    backtrace_symbols_fd(frames + 2, n > 2 ? n - 2 : 0, 2); // skip printStack / onSteadyAllocation
+#else
+    std::fprintf(stderr, "  (no stack traces on this platform)\n");
+#endif
+}
+
+void onSteadyAllocation(size_t size) {
+    uint64_t n = steadyCount.fetch_add(1, std::memory_order_relaxed) + 1;
+    AllocPolicy policy = (AllocPolicy)steadyPolicy.load(std::memory_order_relaxed);
+    if (policy == AllocPolicy::Count || n > LOGGED_STACKS || logging) return;
+    logging = true;
+    const char* name = threadSlot().name.load(std::memory_order_relaxed);
+    std::fprintf(stderr, "steady-state allocation of %zu bytes in frame %lld on thread %s\n", size,
+        currentFrame.load(std::memory_order_relaxed), name ? name : "(unnamed)");
+    printStack();
+    if (n == LOGGED_STACKS) std::fprintf(stderr, "further steady-state allocations are only counted\n");
+    logging = false;
+    if (policy == AllocPolicy::Abort) std::abort();
+}
+
+void countAllocation(size_t size) {
+    ThreadSlot& s = threadSlot();
+    s.allocations.fetch_add(1, std::memory_order_relaxed);
+    s.bytes.fetch_add(size, std::memory_order_relaxed);
+    if (steady.load(std::memory_order_relaxed)) onSteadyAllocation(size);
+}
+
+void countFree(void* p) {
+    if (p) threadSlot().frees.fetch_add(1, std::memory_order_relaxed);
+}
+
+void* allocate(size_t size) {
+    countAllocation(size);
+    return std::malloc(size ? size : 1);
+}
+
+void* allocateAligned(size_t size, std::align_val_t alignment) {
+    countAllocation(size);
+    size_t a = (size_t)alignment < sizeof(void*) ? sizeof(void*) : (size_t)alignment;
+#ifdef _WIN32
+    return _aligned_malloc(size ? size : 1, a);
+#else
+    void* p = nullptr;
+    return posix_memalign(&p, a, size ? size : 1) == 0 ? p : nullptr;
+#endif
+}
+
+void freeAligned(void* p) {
+    countFree(p);
+#ifdef _WIN32
+    _aligned_free(p);
+#else
+    std::free(p);
+#endif
+}
+
+} // namespace
+
+// ---------- Global allocation functions ----------
+void* operator new(size_t size) {
+    if (void* p = allocate(size)) return p;
+    throw std::bad_alloc();
+}
+void* operator new[](size_t size) { return operator new(size); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return allocate(size); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return allocate(size); }
+
+void* operator new(size_t size, std::align_val_t alignment) {
+    if (void* p = allocateAligned(size, alignment)) return p;
+    throw std::bad_alloc();
+}
+void* operator new[](size_t size, std::align_val_t alignment) { return operator new(size, alignment); }
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return allocateAligned(size, alignment);
+}
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return allocateAligned(size, alignment);
+}
+
+void operator delete(void* p) noexcept { countFree(p); std::free(p); }
+void operator delete[](void* p) noexcept { countFree(p); std::free(p); }
+void operator delete(void* p, size_t) noexcept { countFree(p); std::free(p); }
+void operator delete[](void* p, size_t) noexcept { countFree(p); std::free(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { countFree(p); std::free(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { countFree(p); std::free(p); }
+
+void operator delete(void* p, std::align_val_t) noexcept { freeAligned(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { freeAligned(p); }
+void operator delete(void* p, size_t, std::align_val_t) noexcept { freeAligned(p); }
+void operator delete[](void* p, size_t, std::align_val_t) noexcept { freeAligned(p); }
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept { freeAligned(p); }
+void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept { freeAligned(p); }
+
+// ---------- Tracker ----------
+void AllocTracker::beginFrame(long long frame) {
+    int n = threadCount();
+    for (int i = 0; i < n; ++i) {
+        AllocCounts now = read(slots[i]);
+        ThreadSlot& s = slots[i];
+        s.lastFrame.allocations = now.allocations - s.frameStart.allocations;
+        s.lastFrame.bytes = now.bytes - s.frameStart.bytes;
+        s.lastFrame.frees = now.frees - s.frameStart.frees;
+        s.frameStart = now;
+    }
+    currentFrame.store(frame, std::memory_order_relaxed);
+    steady.store(frame >= steadyFrom.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+void AllocTracker::steadyAfter(long long warmupFrames, AllocPolicy policy) {
+#if defined(__GLIBC__)
+    // the first backtrace() loads libgcc; let that happen during warmup
+    void* frame;
+    backtrace(&frame, 1);
+#endif
+    steadyPolicy.store((int)policy, std::memory_order_relaxed);
+    steadyFrom.store(warmupFrames, std::memory_order_relaxed);
+}
+
+uint64_t AllocTracker::steadyAllocations() {
+    return steadyCount.load(std::memory_order_relaxed);
+}
+
+void AllocTracker::setThreadName(const char* name) {
+    threadSlot().name.store(name, std::memory_order_relaxed);
+}
+
+AllocCounts AllocTracker::total(int thread) {
+    if (thread >= 0) return thread < threadCount() ? read(slots[thread]) : AllocCounts();
+    AllocCounts sum;
+    for (int i = 0; i < threadCount(); ++i) {
+        AllocCounts c = read(slots[i]);
+        sum.allocations += c.allocations;
+        sum.bytes += c.bytes;
+        sum.frees += c.frees;
+    }
+    return sum;
+}
+
+AllocCounts AllocTracker::lastFrame(int thread) {
+    if (thread >= 0) return thread < threadCount() ? slots[thread].lastFrame : AllocCounts();
+    AllocCounts sum;
+    for (int i = 0; i < threadCount(); ++i) {
+        sum.allocations += slots[i].lastFrame.allocations;
+        sum.bytes += slots[i].lastFrame.bytes;
+        sum.frees += slots[i].lastFrame.frees;
+    }
+    return sum;
+}
+
+int AllocTracker::threadCount() {
+    int n = slotsUsed.load(std::memory_order_relaxed);
+    return n < MAX_THREADS ? n : MAX_THREADS;
+}
+
+const char* AllocTracker::threadName(int thread) {
+    const char* name = thread >= 0 && thread < threadCount() ? slots[thread].name.load(std::memory_order_relaxed) : nullptr;
+    return name ? name : "(unnamed)";
+}
+
+#else
+
+void AllocTracker::beginFrame(long long) {}
+void AllocTracker::steadyAfter(long long, AllocPolicy) {}
+uint64_t AllocTracker::steadyAllocations() { return 0; }
+void AllocTracker::setThreadName(const char*) {}
+AllocCounts AllocTracker::total(int) { return AllocCounts(); }
+AllocCounts AllocTracker::lastFrame(int) { return AllocCounts(); }
+int AllocTracker::threadCount() { return 0; }
+const char* AllocTracker::threadName(int) { return "(unnamed)"; }
+
+#endif
+
+void AllocTracker::printReport() {
+    if (!enabled()) {
+        std::printf("allocations: not tracked (build with SMOKE_ALLOC_TRACKING=ON)\n");
+        return;
+    }
+    AllocCounts all = total(), frame = lastFrame();
+    std::printf("allocations: %llu (%.1f KB), %llu frees; last frame %llu (%llu bytes); steady state %llu\n",
+        (unsigned long long)all.allocations, all.bytes / 1024.0, (unsigned long long)all.frees,
+        (unsigned long long)frame.allocations, (unsigned long long)frame.bytes, (unsigned long long)steadyAllocations());
+    for (int i = 0; i < threadCount(); ++i) {
+        AllocCounts t = total(i), f = lastFrame(i);
+        std::printf("  thread %d %s: %llu (%.1f KB), last frame %llu\n", i + 1, threadName(i),
+            (unsigned long long)t.allocations, t.bytes / 1024.0, (unsigned long long)f.allocations);
+    }
+}
@@ -0,0 +1,59 @@
+#ifndef ALLOC_TRACKER_H
+#define ALLOC_TRACKER_H
+
+#include <cstdint>
+
+// ---------- Allocation tracker ----------
+// Instrumentation build only (cmake -DSMOKE_ALLOC_TRACKING=ON): alloc_tracker.cpp
+// then replaces the global operator new / delete and counts every allocation,
+// its bytes and every free, per thread and in total. The frame loop calls
+// beginFrame() once per frame; after steadyAfter(warmup) any allocation in a
+// later frame is a steady-state allocation and is counted, logged with a
+// stack or aborts, depending on the policy. Counting costs a few relaxed
+// atomics per allocation and takes no lock. C malloc() is not hooked, so
+// allocations inside the GL driver or GLFW don't show up.
+// With SMOKE_ALLOC_TRACKING=0 every call is a no-op and enabled() is false.
+#ifndef SMOKE_ALLOC_TRACKING
+#define SMOKE_ALLOC_TRACKING 0
+#endif
+
+struct AllocCounts {
+    uint64_t allocations = 0, bytes = 0, frees = 0;
+};
+
+enum class AllocPolicy {
+    Count, // just count steady-state allocations
+    Log,   // count, and print size, thread and stack of the first few
+    Abort, // print the first one and abort, e.g. under a debugger
+};
+
+class AllocTracker {
+public:
+    static const int MAX_THREADS = 64; // later threads share the last slot
+
+    static bool enabled() { return SMOKE_ALLOC_TRACKING != 0; }
+
+    // called by the owning loop at the start of every frame
+    static void beginFrame(long long frame);
+
+    // frames after `warmupFrames` must not allocate
+    static void steadyAfter(long long warmupFrames, AllocPolicy policy = AllocPolicy::Log);
+
+    // allocations (on any thread) in steady-state frames so far
+    static uint64_t steadyAllocations();
+
+    // labels the calling thread in reports; must be a string literal / outlive the tracker
+    static void setThreadName(const char* name);
+
+    // thread = -1: summed over all threads
+    static AllocCounts total(int thread = -1);     // since startup
+    static AllocCounts lastFrame(int thread = -1); // between the last two beginFrame() calls
+
+    static int threadCount();
+    static const char* threadName(int thread);
+
+    // per-thread totals and last-frame counts to stdout
+    static void printReport();
+};
+
+#endif // ALLOC_TRACKER_H
@@ -0,0 +1,58 @@
+#ifndef BUDGET_H
+#define BUDGET_H
+
+#include <glm/glm.hpp>
+
+// ---------- Frame budget controller ----------
+// AIMD loop on the smoothed per-frame work time (simulation + render, not the
+// vsync wait). Over the target it cuts the particle budget multiplicatively,
+// under it it grows the budget additively. Inside the deadband nothing
+// changes, and growth pauses for a while after every cut, so the budget
+// settles instead of oscillating around the target.
+struct BudgetSettings {
+    bool enabled = false;
+    float targetMs = 12.0f;
+    float minFraction = 0.1f;       // of the configured maximum particle count
+    float maxFraction = 1.0f;
+    float deadband = 0.1f;          // +-10% around the target counts as on target
+    float increaseStep = 0.02f;     // added per adjustment while under budget
+    float decreaseFactor = 0.8f;    // applied per adjustment while over budget
+    float smoothing = 0.1f;         // EMA weight of each new frame sample
+    float interval = 0.25f;         // seconds between adjustments
+    float holdAfterDecrease = 1.0f; // seconds without growth after a cut
+};
+
+class BudgetController {
+public:
+    float fraction = 1.0f; // current particle cap / spawn rate scale
+    float smoothedMs = 0.0f;
+
+    // feed one frame's work time; returns the (possibly adjusted) fraction
+    float update(const BudgetSettings& s, float workMs, float dt) {
+        smoothedMs = smoothedMs > 0.0f ? glm::mix(smoothedMs, workMs, s.smoothing) : workMs;
+        if (!s.enabled) {
+            fraction = s.maxFraction;
+            return fraction;
+        }
+        sinceAdjust += dt;
+        sinceDecrease += dt;
+        if (sinceAdjust < s.interval) return fraction;
+        sinceAdjust = 0.0f;
+
+        if (smoothedMs > s.targetMs * (1.0f + s.deadband)) {
+            fraction *= s.decreaseFactor;
+            sinceDecrease = 0.0f;
+        }
+        else if (smoothedMs < s.targetMs * (1.0f - s.deadband) && sinceDecrease >= s.holdAfterDecrease) {
+            fraction += s.increaseStep;
+        }
+        fraction = glm::clamp(fraction, s.minFraction, s.maxFraction);
+        return fraction;
+    }
+
+private:
+    float sinceAdjust = 0.0f;
+    float sinceDecrease = 1e9f;
+};
+
+#endif // BUDGET_H
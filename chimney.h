@@ -2,6 +2,7 @@
 #define CHIMNEY_H
 
 #include <glad/glad.h>
+#include "gl_handles.h"
 #include "shader.h"
 
 // Hollow chimney with inner and outer walls, no top.
@@ -86,16 +87,18 @@ public:
             32,33,34, 34,35,32
         };
 
-        glGenVertexArrays(1, &VAO);
-        glGenBuffers(1, &VBO);
-        glGenBuffers(1, &EBO);
+        VAO.create("Chimney");
+        VBO.create("Chimney vertices");
+        EBO.create("Chimney indices");
 
         glBindVertexArray(VAO);
         glBindBuffer(GL_ARRAY_BUFFER, VBO);
         glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+        VBO.setBytes(sizeof(vertices));
 
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
         glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+        EBO.setBytes(sizeof(indices));
 
         // position (location = 0)
         glEnableVertexAttribArray(0);
@@ -112,10 +115,11 @@ public:
         glBindVertexArray(0);
     }
 
-    ~Chimney() {
-        if (EBO) glDeleteBuffers(1, &EBO);
-        if (VBO) glDeleteBuffers(1, &VBO);
-        if (VAO) glDeleteVertexArrays(1, &VAO);
+    // call while the context is still current
+    void release() {
+        EBO.reset();
+        VBO.reset();
+        VAO.reset();
     }
 
     void Draw(const Shader& shader, const glm::mat4& model) const {
@@ -128,7 +132,8 @@ public:
 
 
 private:
-    GLuint VAO = 0, VBO = 0, EBO = 0;
+    GlVertexArray VAO;
+    GlBuffer VBO, EBO;
 };
 
 #endif // CHIMNEY_H
@@ -0,0 +1,71 @@
+#ifndef CULLING_H
+#define CULLING_H
+
+#include <glm/glm.hpp>
+#include "particles.h"
+
+// ---------- View frustum ----------
+// Planes are stored as (n, d) with n normalized; a point is inside when dot(n, p) + d >= 0.
+struct Frustum {
+    glm::vec4 planes[6];
+
+    // Gribb/Hartmann extraction from a projection * view matrix.
+    static Frustum fromMatrix(const glm::mat4& m) {
+        Frustum f;
+        glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+        glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+        glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+        glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+        f.planes[0] = row3 + row0; // left
+        f.planes[1] = row3 - row0; // right
+        f.planes[2] = row3 + row1; // bottom
+        f.planes[3] = row3 - row1; // top
+        f.planes[4] = row3 + row2; // near
+        f.planes[5] = row3 - row2; // far
+        for (glm::vec4& pl : f.planes)
+            pl = pl / glm::length(glm::vec3(pl.x, pl.y, pl.z));
+        return f;
+    }
+
+    // pulls the far plane in to `maxDistance` along the view direction (no-op if it is already closer)
+    void clampDistance(const glm::vec3& camPos, const glm::vec3& forward, float maxDistance) {
+        glm::vec4 limit(-forward.x, -forward.y, -forward.z, glm::dot(forward, camPos) + maxDistance);
+        glm::vec3 farN(planes[5].x, planes[5].y, planes[5].z);
+        float farDist = planes[5].w + glm::dot(farN, camPos);
+        if (maxDistance < farDist) planes[5] = limit;
+    }
+
+    bool sphereVisible(const glm::vec3& c, float r) const {
+        for (const glm::vec4& pl : planes)
+            if (pl.x * c.x + pl.y * c.y + pl.z * c.z + pl.w < -r) return false;
+        return true;
+    }
+};
+
+// ---------- Particle culling ----------
+struct CullSettings {
+    bool enabled = true;
+    float maxDistance = 0.0f; // 0 = only the projection's far plane
+};
+
+struct CullStats {
+    int tested = 0, visible = 0, culled = 0;
+};
+
+// Compacts the particles whose billboard can touch the view volume to the front
+// of `out` and returns how many were kept. `out` may alias `in`.
+inline int cullParticles(const GPUParticle* in, int count, const Frustum& frustum, GPUParticle* out, CullStats& stats) {
+    int visible = 0;
+    for (int i = 0; i < count; ++i) {
+        const GPUParticle& g = in[i];
+        // billboard is a square of half-extent `size`, so the corners sit at size * sqrt(2)
+        if (frustum.sphereVisible(glm::vec3(g.px, g.py, g.pz), g.size * 1.41421356f))
+            out[visible++] = g;
+    }
+    stats.tested = count;
+    stats.visible = visible;
+    stats.culled = count - visible;
+    return visible;
+}
+
+#endif // CULLING_H
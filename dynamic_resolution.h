@@ -0,0 +1,50 @@
+#ifndef DYNAMIC_RESOLUTION_H
+#define DYNAMIC_RESOLUTION_H
+
+#include <glm/glm.hpp>
+#include <cmath>
+
+// ---------- Dynamic resolution ----------
+// Picks the fraction of the window resolution the scene is rendered at from
+// the measured GPU frame time. Fill cost grows with the pixel count, i.e. with
+// scale^2, so the ideal scale for a measured time is scale * sqrt(target / ms).
+// Every frame the scale moves a share of the way towards it; inside the
+// deadband it holds, and the render size only changes in `quantum` steps.
+struct DynamicResolutionSettings {
+    bool enabled = false;
+    float targetMs = 8.0f;
+    float minScale = 0.5f;
+    float maxScale = 1.0f;
+    float deadband = 0.1f;   // +-10% around the target counts as on target
+    float smoothing = 0.2f;  // EMA weight of each new GPU sample
+    float gain = 0.1f;       // share of the distance to the ideal scale covered per frame
+    float quantum = 0.05f;   // render size granularity, as a fraction of the window
+};
+
+class ResolutionController {
+public:
+    float scale = 1.0f;
+    float smoothedMs = 0.0f;
+
+    // gpuMs <= 0 means no new measurement this frame
+    float update(const DynamicResolutionSettings& s, float gpuMs) {
+        if (!s.enabled) {
+            scale = s.maxScale;
+            return scale;
+        }
+        if (gpuMs <= 0.0f) return scale;
+        smoothedMs = smoothedMs > 0.0f ? glm::mix(smoothedMs, gpuMs, s.smoothing) : gpuMs;
+        if (std::fabs(smoothedMs - s.targetMs) <= s.targetMs * s.deadband) return scale;
+        float ideal = scale * std::sqrt(s.targetMs / smoothedMs);
+        scale = glm::clamp(glm::mix(scale, ideal, s.gain), s.minScale, s.maxScale);
+        return scale;
+    }
+
+    // render target size for a window dimension, snapped to the quantum
+    int renderSize(const DynamicResolutionSettings& s, int windowSize) const {
+        float q = s.quantum > 0.0f ? std::round(scale / s.quantum) * s.quantum : scale;
+        return glm::max(1, (int)(windowSize * glm::clamp(q, s.minScale, s.maxScale) + 0.5f));
+    }
+};
+
+#endif // DYNAMIC_RESOLUTION_H
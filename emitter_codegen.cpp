@@ -0,0 +1,252 @@
+#include "emitter_codegen.h"
+#include <algorithm>
+#include <cmath>
+
+// bump when a snippet changes, so no cache mixes up old and new programs
+static const uint32_t CODEGEN_VERSION = 1;
+
+float Curve::eval(float t) const {
+    if (keys.empty()) return 1.0f;
+    if (t <= keys.front().t) return keys.front().value;
+    for (size_t k = 1; k < keys.size(); ++k) {
+        const CurveKey& a = keys[k - 1];
+        const CurveKey& b = keys[k];
+        if (t <= b.t) return b.t > a.t ? a.value + (b.value - a.value) * (t - a.t) / (b.t - a.t) : b.value;
+    }
+    return keys.back().value;
+}
+
+int GpuEmitterType::capacity() const {
+    // a puff of slack for the spawn accumulator's rounding
+    return std::max(1, (int)std::ceil(spawnRate * lifeSpan) + 1);
+}
+
+std::vector<float> bakeCurve(const Curve& curve, int size) {
+    std::vector<float> lut(std::max(size, 2));
+    for (size_t i = 0; i < lut.size(); ++i) lut[i] = curve.eval((float)i / (lut.size() - 1));
+    return lut;
+}
+
+uint64_t programKey(const GpuEmitterType& type) {
+    // FNV-1a over the structural fields
+    const uint32_t fields[] = { CODEGEN_VERSION, (uint32_t)type.shape, type.forces, type.trackBounds ? 1u : 0u };
+    uint64_t h = 0xcbf29ce484222325ull;
+    for (uint32_t f : fields)
+        for (int b = 0; b < 4; ++b) {
+            h ^= (f >> (b * 8)) & 0xff;
+            h *= 0x100000001b3ull;
+        }
+    return h;
+}
+
+// ---------- Snippets ----------
+// Slot state, std430: posLife = position + life, vel = velocity + unused.
+// The render buffer holds GPUParticles (5 floats each) for SceneRenderer;
+// their life is written as 1 - alpha so every smoke path fades them by the
+// alpha curve.
+static const char* HEADER = R"(
+layout(local_size_x = GROUP) in;
+
+struct Slot { vec4 posLife; vec4 vel; };
+layout(std430, binding = 0) buffer Slots { Slot slots[]; };
+layout(std430, binding = 1) writeonly buffer Render { float render[]; };
+
+uniform uint slotCount;
+uniform uint spawnFirst;  // slots [spawnFirst, spawnFirst + spawnCount) of the ring are reborn this step
+uniform uint spawnCount;
+uniform uint seed;
+uniform float dt, time;
+uniform vec3 emitterPos;
+uniform float spawnRadius, upSpeedMin, upSpeedMax, invLifeSpan, sizeBase;
+uniform float heightBase, invSpreadHeight;
+uniform sampler1D sizeLut, alphaLut;
+
+uint pcg(uint v) {
+    uint state = v * 747796405u + 2891336453u;
+    uint word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+    return (word >> 22u) ^ word;
+}
+float rand(inout uint s) { s = pcg(s); return float(s >> 8) * (1.0 / 16777216.0); }
+
+float lut(sampler1D curve, float t) {
+    return textureLod(curve, (t * float(LUT_SIZE - 1) + 0.5) / float(LUT_SIZE), 0.0).r;
+}
+)";
+
+static const char* SPAWN_POINT = R"(
+vec3 spawnOffset(inout uint rng) { return vec3(0.0); }
+)";
+
+static const char* SPAWN_DISC = R"(
+vec3 spawnOffset(inout uint rng) {
+    float angle = rand(rng) * 6.28318531;
+    float r = rand(rng) * spawnRadius;
+    return vec3(cos(angle) * r, 0.0, sin(angle) * r);
+}
+)";
+
+static const char* SPAWN_SPHERE = R"(
+vec3 spawnOffset(inout uint rng) {
+    float z = rand(rng) * 2.0 - 1.0;
+    float angle = rand(rng) * 6.28318531;
+    float r = spawnRadius * pow(rand(rng), 1.0 / 3.0);
+    return vec3(sqrt(1.0 - z * z) * vec2(cos(angle), sin(angle)), z).xzy * r;
+}
+)";
+
+// noise.h's perlin / noiseVelocity, same permutation table
+static const char* NOISE = R"(
+layout(std430, binding = 2) readonly buffer Perm { int perm[]; };
+
+float fade(float t) { return t * t * t * (t * (t * 6.0 - 15.0) + 10.0); }
+float grad(int hash, float x, float y, float z) {
+    int h = hash & 15;
+    float u = h < 8 ? x : y;
+    float v = h < 4 ? y : (h == 12 || h == 14 ? x : z);
+    return ((h & 1) != 0 ? -u : u) + ((h & 2) != 0 ? -v : v);
+}
+float perlin(vec3 p) {
+    vec3 f = floor(p);
+    int X = int(f.x) & 255, Y = int(f.y) & 255, Z = int(f.z) & 255;
+    p -= f;
+    float u = fade(p.x), v = fade(p.y), w = fade(p.z);
+    int A = perm[X] + Y, AA = perm[A] + Z, AB = perm[A + 1] + Z;
+    int B = perm[X + 1] + Y, BA = perm[B] + Z, BB = perm[B + 1] + Z;
+    float res = mix(mix(mix(grad(perm[AA], p.x, p.y, p.z),
+        grad(perm[BA], p.x - 1.0, p.y, p.z), u),
+        mix(grad(perm[AB], p.x, p.y - 1.0, p.z),
+            grad(perm[BB], p.x - 1.0, p.y - 1.0, p.z), u), v),
+        mix(mix(grad(perm[AA + 1], p.x, p.y, p.z - 1.0),
+            grad(perm[BA + 1], p.x - 1.0, p.y, p.z - 1.0), u),
+            mix(grad(perm[AB + 1], p.x, p.y - 1.0, p.z - 1.0),
+                grad(perm[BB + 1], p.x - 1.0, p.y - 1.0, p.z - 1.0), u), v), w);
+    return (res + 1.0) * 0.5;
+}
+vec3 noiseVelocity(vec3 pos, float time) {
+    const float scale = 0.8;
+    float nX = perlin(vec3(pos.x * scale + time * 0.2, pos.y * scale, pos.z * scale)) - 0.5;
+    float nZ = perlin(vec3(pos.z * scale, pos.x * scale + time * 0.3, pos.y * scale)) - 0.5;
+    return vec3(nX, 0.0, nZ) * 1.2;
+}
+)";
+
+static const char* FORCE_UNIFORMS = R"(
+uniform float lift, horizontalSpread, stepDamping;
+)";
+
+// the live bounds as order-preserving uints: min xyz, then max xyz
+static const char* BOUNDS = R"(
+layout(std430, binding = 3) buffer Bounds { uint bounds[6]; };
+shared vec3 groupMin[GROUP], groupMax[GROUP];
+
+uint orderedBits(float f) {
+    uint u = floatBitsToUint(f);
+    return (u & 0x80000000u) != 0u ? ~u : u | 0x80000000u;
+}
+)";
+
+static const char* MAIN_BEGIN = R"(
+void main() {
+    // the last group's tail recomputes the last slot and writes nothing
+    bool inRange = gl_GlobalInvocationID.x < slotCount;
+    uint i = min(gl_GlobalInvocationID.x, slotCount - 1u);
+    vec3 pos = slots[i].posLife.xyz, vel = slots[i].vel.xyz;
+    float life = slots[i].posLife.w;
+
+    bool born = (i + slotCount - spawnFirst) % slotCount < spawnCount;
+    uint rng = pcg(i ^ pcg(seed));
+    vec3 spawnPos = emitterPos + spawnOffset(rng);
+    float r0 = rand(rng), r1 = rand(rng), r2 = rand(rng);
+    vec3 spawnVel = vec3((r0 - 0.5) * 0.02, mix(upSpeedMin, upSpeedMax, r1), (r2 - 0.5) * 0.02);
+    pos = born ? spawnPos : pos;
+    vel = born ? spawnVel : vel;
+    life = born ? 0.0 : life;
+
+    life += dt * invLifeSpan;
+    float hFactor = clamp((pos.y - heightBase) * invSpreadHeight, 0.0, 1.0);
+)";
+
+static const char* FORCE_DRIFT = R"(
+    vel.y += lift * dt;
+)";
+
+static const char* FORCE_FLOW = R"(
+    vel += noiseVelocity(pos, time) * dt * (0.4 + 1.6 * hFactor);
+)";
+
+static const char* FORCE_SPREAD = R"(
+    vel.xz += normalize(pos.xz - emitterPos.xz + 1e-6) * (horizontalSpread * dt * hFactor);
+)";
+
+static const char* FORCE_DAMPING = R"(
+    vel *= stepDamping;
+)";
+
+static const char* MAIN_SHADE = R"(
+    pos += vel * dt;
+    float t = clamp(life, 0.0, 1.0);
+    float alpha = lut(alphaLut, t) * float(life < 1.0);
+    float size = sizeBase * lut(sizeLut, t);
+)";
+
+static const char* MAIN_BOUNDS = R"(
+    bool alive = inRange && life < 1.0;
+    uint l = gl_LocalInvocationID.x;
+    groupMin[l] = alive ? pos - vec3(size) : vec3(1e30);
+    groupMax[l] = alive ? pos + vec3(size) : vec3(-1e30);
+    memoryBarrierShared();
+    barrier();
+    for (uint s = GROUP / 2u; s > 0u; s >>= 1) {
+        if (l < s) {
+            groupMin[l] = min(groupMin[l], groupMin[l + s]);
+            groupMax[l] = max(groupMax[l], groupMax[l + s]);
+        }
+        memoryBarrierShared();
+        barrier();
+    }
+    if (l == 0u) {
+        for (int c = 0; c < 3; ++c) {
+            atomicMin(bounds[c], orderedBits(groupMin[0][c]));
+            atomicMax(bounds[3 + c], orderedBits(groupMax[0][c]));
+        }
+    }
+)";
+
+static const char* MAIN_END = R"(
+    if (inRange) {
+        slots[i].posLife = vec4(pos, life);
+        slots[i].vel = vec4(vel, 0.0);
+        uint o = i * 5u;
+        render[o + 0u] = pos.x;
+        render[o + 1u] = pos.y;
+        render[o + 2u] = pos.z;
+        render[o + 3u] = size;
+        render[o + 4u] = 1.0 - alpha;
+    }
+}
+)";
+
+std::string generateEmitterShader(const GpuEmitterType& type) {
+    std::string src = "#version 450 core\n";
+    src += "#define GROUP " + std::to_string(GPU_EMITTER_GROUP) + "u\n";
+    src += "#define LUT_SIZE " + std::to_string(CURVE_LUT_SIZE) + "\n";
+    src += HEADER;
+    switch (type.shape) {
+    case SpawnShape::Point: src += SPAWN_POINT; break;
+    case SpawnShape::Sphere: src += SPAWN_SPHERE; break;
+    default: src += SPAWN_DISC; break;
+    }
+    if (type.forces & GPU_FORCE_FLOW) src += NOISE;
+    if (type.forces) src += FORCE_UNIFORMS;
+    if (type.trackBounds) src += BOUNDS;
+
+    src += MAIN_BEGIN;
+    if (type.forces & GPU_FORCE_DRIFT) src += FORCE_DRIFT;
+    if (type.forces & GPU_FORCE_FLOW) src += FORCE_FLOW;
+    if (type.forces & GPU_FORCE_SPREAD) src += FORCE_SPREAD;
+    if (type.forces & GPU_FORCE_DAMPING) src += FORCE_DAMPING;
+    src += MAIN_SHADE;
+    if (type.trackBounds) src += MAIN_BOUNDS;
+    src += MAIN_END;
+    return src;
+}
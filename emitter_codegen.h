@@ -0,0 +1,78 @@
+#ifndef EMITTER_CODEGEN_H
+#define EMITTER_CODEGEN_H
+
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// ---------- GPU emitter types ----------
+// Data-defined behaviour of an emitter simulated on the GPU (gpu_emitter.h).
+// The module choices (spawn shape, forces, bounds) are structural: they pick
+// the GLSL snippets its compute kernel is assembled from, so every kernel
+// holds exactly the code its type uses and no branches on the configuration.
+// Types with the same modules share one program. Everything numeric is a
+// uniform, and the curves are baked into 1D lookup textures.
+
+enum class SpawnShape : uint32_t {
+    Point,
+    Disc,   // horizontal, spawnRadius, like the CPU emitter
+    Sphere, // solid, spawnRadius
+};
+
+// force modules; the kernel applies them in this order
+enum GpuForce : uint32_t {
+    GPU_FORCE_DRIFT = 1u << 0,   // constant upward acceleration `lift`
+    GPU_FORCE_FLOW = 1u << 1,    // Perlin flow growing with height (noiseVelocity)
+    GPU_FORCE_SPREAD = 1u << 2,  // push away from the emitter axis growing with height
+    GPU_FORCE_DAMPING = 1u << 3, // per-frame velocity damping
+};
+
+struct CurveKey {
+    float t, value;
+};
+
+// piecewise linear over life 0..1 through keys sorted by t, flat beyond the
+// first and last key; no keys = 1 everywhere
+struct Curve {
+    std::vector<CurveKey> keys;
+    float eval(float t) const;
+};
+
+struct GpuEmitterType {
+    // --- structural ---
+    SpawnShape shape = SpawnShape::Disc;
+    uint32_t forces = GPU_FORCE_DRIFT | GPU_FORCE_FLOW | GPU_FORCE_SPREAD | GPU_FORCE_DAMPING;
+    bool trackBounds = false; // also reduce the live particles' bounds (for the volume smoke path)
+
+    // --- parameters; the defaults are the CPU chimney's ---
+    glm::vec3 pos = glm::vec3(0.7f, 1.5f, -1.0f);
+    float spawnRadius = 0.03f;
+    float spawnRate = 4.0f / 0.12f; // particles per second
+    float upSpeedMin = 1.0f, upSpeedMax = 1.8f;
+    float lifeSpan = 22.0f;         // one lifetime for all, so the slots are reused in spawn order
+    float sizeBase = 0.15f;
+    float lift = 0.5f;
+    float horizontalSpread = 0.3f;
+    float spreadHeight = 4.0f, heightOffset = 1.0f; // as in Emitter, for flow and spread
+    float dampingPerFrame = 0.995f; // per 60 Hz frame
+    Curve sizeOverLife = { { { 0.0f, 1.0f }, { 0.3f, 1.5f }, { 1.0f, 1.7f } } }; // times sizeBase
+    Curve alphaOverLife = { { { 0.0f, 1.0f }, { 1.0f, 0.0f } } };                // the CPU path's 1 - life
+
+    // particle slots the type needs at its rate and lifetime
+    int capacity() const;
+};
+
+const int CURVE_LUT_SIZE = 64;
+const int GPU_EMITTER_GROUP = 256; // local size of the generated kernels
+
+// samples the curve at `size` evenly spaced lives from 0 to 1 inclusive
+std::vector<float> bakeCurve(const Curve& curve, int size = CURVE_LUT_SIZE);
+
+// hash of the structural fields only: equal keys, same program
+uint64_t programKey(const GpuEmitterType& type);
+
+// GLSL 4.50 compute source of the type's update kernel
+std::string generateEmitterShader(const GpuEmitterType& type);
+
+#endif // EMITTER_CODEGEN_H
@@ -0,0 +1,111 @@
+#ifndef GL_HANDLES_H
+#define GL_HANDLES_H
+
+#include <glad/glad.h>
+#include <cstddef>
+#include "gl_registry.h"
+
+// ---------- GL handles ----------
+// Move-only owner of one GL object. create() makes the object (deleting the
+// one it held) and enters it in GlRegistry under `site`; reset() and the
+// destructor delete it and take it out again. Owners keep their release(),
+// which resets their handles while the context is still current, so the
+// destructors that run after the context is gone find nothing to delete.
+// A handle converts to GLuint and goes straight into GL calls.
+template <GlKind K>
+class GlHandle {
+public:
+    GlHandle() = default;
+    ~GlHandle() { reset(); }
+
+    GlHandle(GlHandle&& other) noexcept : id(other.id) { other.id = 0; }
+    GlHandle& operator=(GlHandle&& other) noexcept {
+        if (this != &other) {
+            reset();
+            id = other.id;
+            other.id = 0;
+        }
+        return *this;
+    }
+    GlHandle(const GlHandle&) = delete;
+    GlHandle& operator=(const GlHandle&) = delete;
+
+    void create(const char* site) {
+        reset();
+        id = generate();
+        if (id) GlRegistry::add(K, id, site);
+    }
+
+    void reset() {
+        if (!id) return;
+        GlRegistry::remove(K, id);
+        destroy(id);
+        id = 0;
+    }
+
+    // memory behind the object, for the registry's totals
+    void setBytes(size_t bytes) const {
+        if (id) GlRegistry::setBytes(K, id, bytes);
+    }
+
+    operator GLuint() const { return id; }
+
+private:
+    GLuint id = 0;
+
+    static GLuint generate();
+    static void destroy(GLuint id);
+};
+
+template <> inline GLuint GlHandle<GlKind::Buffer>::generate() { GLuint id = 0; glGenBuffers(1, &id); return id; }
+template <> inline GLuint GlHandle<GlKind::Texture>::generate() { GLuint id = 0; glGenTextures(1, &id); return id; }
+template <> inline GLuint GlHandle<GlKind::VertexArray>::generate() { GLuint id = 0; glGenVertexArrays(1, &id); return id; }
+template <> inline GLuint GlHandle<GlKind::Program>::generate() { return glCreateProgram(); }
+template <> inline GLuint GlHandle<GlKind::Framebuffer>::generate() { GLuint id = 0; glGenFramebuffers(1, &id); return id; }
+template <> inline GLuint GlHandle<GlKind::Renderbuffer>::generate() { GLuint id = 0; glGenRenderbuffers(1, &id); return id; }
+
+template <> inline void GlHandle<GlKind::Buffer>::destroy(GLuint id) { glDeleteBuffers(1, &id); }
+template <> inline void GlHandle<GlKind::Texture>::destroy(GLuint id) { glDeleteTextures(1, &id); }
+template <> inline void GlHandle<GlKind::VertexArray>::destroy(GLuint id) { glDeleteVertexArrays(1, &id); }
+template <> inline void GlHandle<GlKind::Program>::destroy(GLuint id) { glDeleteProgram(id); }
+template <> inline void GlHandle<GlKind::Framebuffer>::destroy(GLuint id) { glDeleteFramebuffers(1, &id); }
+template <> inline void GlHandle<GlKind::Renderbuffer>::destroy(GLuint id) { glDeleteRenderbuffers(1, &id); }
+
+using GlBuffer = GlHandle<GlKind::Buffer>;
+using GlTexture = GlHandle<GlKind::Texture>;
+using GlVertexArray = GlHandle<GlKind::VertexArray>;
+using GlProgram = GlHandle<GlKind::Program>;
+using GlFramebuffer = GlHandle<GlKind::Framebuffer>;
+using GlRenderbuffer = GlHandle<GlKind::Renderbuffer>;
+
+// Bytes per texel of the formats used here. Unsized formats count as what
+// drivers typically store: RGB is padded to 4 bytes.
+inline size_t glTexelBytes(GLenum format) {
+    switch (format) {
+    case GL_RED: case GL_R8: return 1;
+    case GL_RG: case GL_RG8: case GL_R16F: return 2;
+    case GL_R32F: case GL_R32UI: case GL_RGB: case GL_RGB8: case GL_RGBA: case GL_RGBA8:
+    case GL_DEPTH24_STENCIL8: return 4;
+    case GL_RGBA16F: return 8;
+    case GL_RGBA32F: return 16;
+    default: return 4;
+    }
+}
+
+// pixel format of an 8-bit image with 1-4 components, as stb_image decodes them
+inline GLenum glComponentFormat(int components) {
+    switch (components) {
+    case 1: return GL_RED;
+    case 2: return GL_RG;
+    case 3: return GL_RGB;
+    default: return GL_RGBA;
+    }
+}
+
+// a width x height x depth image, plus a third for its mip chain
+inline size_t glImageBytes(GLenum format, int width, int height = 1, int depth = 1, bool mipmapped = false) {
+    size_t bytes = glTexelBytes(format) * (size_t)width * height * depth;
+    return mipmapped ? bytes + bytes / 3 : bytes;
+}
+
+#endif // GL_HANDLES_H
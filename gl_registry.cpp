@@ -0,0 +1,92 @@
+#include "gl_registry.h"
+#include <algorithm>
+#include <iomanip>
+#include <vector>
+
+size_t GlRegistry::liveBytes = 0;
+size_t GlRegistry::peak = 0;
+
+static uint64_t key(GlKind kind, uint32_t name) {
+    return (uint64_t)kind << 32 | name;
+}
+
+std::unordered_map<uint64_t, GlRegistry::Entry>& GlRegistry::live() {
+    static std::unordered_map<uint64_t, Entry> entries;
+    return entries;
+}
+
+void GlRegistry::add(GlKind kind, uint32_t name, const char* site) {
+    // GL reuses deleted names; a stale entry means its delete bypassed the handle
+    remove(kind, name);
+    live()[key(kind, name)] = Entry{ kind, name, 0, site ? site : "" };
+}
+
+void GlRegistry::setBytes(GlKind kind, uint32_t name, size_t bytes) {
+    auto it = live().find(key(kind, name));
+    if (it == live().end()) return;
+    liveBytes = liveBytes - it->second.bytes + bytes;
+    it->second.bytes = bytes;
+    peak = std::max(peak, liveBytes);
+}
+
+void GlRegistry::remove(GlKind kind, uint32_t name) {
+    auto it = live().find(key(kind, name));
+    if (it == live().end()) return;
+    liveBytes -= it->second.bytes;
+    live().erase(it);
+}
+
+GlRegistry::Totals GlRegistry::totals(GlKind kind) {
+    Totals t;
+    for (const auto& e : live()) {
+        if (e.second.kind != kind) continue;
+        ++t.count;
+        t.bytes += e.second.bytes;
+    }
+    return t;
+}
+
+GlRegistry::Totals GlRegistry::totals() {
+    Totals t;
+    t.count = (int)live().size();
+    t.bytes = liveBytes;
+    return t;
+}
+
+size_t GlRegistry::peakBytes() {
+    return peak;
+}
+
+const char* GlRegistry::kindName(GlKind kind) {
+    switch (kind) {
+    case GlKind::Buffer: return "buffer";
+    case GlKind::Texture: return "texture";
+    case GlKind::VertexArray: return "vertex array";
+    case GlKind::Program: return "program";
+    case GlKind::Framebuffer: return "framebuffer";
+    case GlKind::Renderbuffer: return "renderbuffer";
+    default: return "?";
+    }
+}
+
+void GlRegistry::printTotals(std::ostream& out) {
+    out << std::fixed << std::setprecision(2);
+    for (int k = 0; k < (int)GlKind::Count; ++k) {
+        Totals t = totals((GlKind)k);
+        if (t.count) out << "  " << kindName((GlKind)k) << "s: " << t.count << ", " << t.bytes / 1048576.0 << " MB\n";
+    }
+    Totals all = totals();
+    out << "GL objects: " << all.count << ", " << all.bytes / 1048576.0 << " MB (peak " << peak / 1048576.0 << " MB)\n";
+    out << std::defaultfloat;
+}
+
+int GlRegistry::reportLeaks(std::ostream& out) {
+    std::vector<const Entry*> leaks;
+    for (const auto& e : live()) leaks.push_back(&e.second);
+    std::sort(leaks.begin(), leaks.end(), [](const Entry* a, const Entry* b) {
+        return a->bytes != b->bytes ? a->bytes > b->bytes : a->site < b->site;
+    });
+    for (const Entry* e : leaks)
+        out << "GL leak: " << kindName(e->kind) << " " << e->name << ", " << e->bytes << " bytes, from " << e->site << "\n";
+    return (int)leaks.size();
+}
@@ -0,0 +1,62 @@
+#ifndef GL_REGISTRY_H
+#define GL_REGISTRY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+
+// ---------- GL resource registry ----------
+// Bookkeeping of every live GL buffer, texture, vertex array, program,
+// framebuffer and renderbuffer: its name, the memory behind it and where it
+// was created. The handles in gl_handles.h add themselves on create() and
+// remove themselves on reset(); owners only report sizes. Like GL itself it
+// belongs to the context's thread and takes no lock. It makes no GL calls,
+// so it lives in smoke_core.
+enum class GlKind : uint8_t {
+    Buffer,
+    Texture,
+    VertexArray,
+    Program,
+    Framebuffer,
+    Renderbuffer,
+    Count
+};
+
+class GlRegistry {
+public:
+    struct Entry {
+        GlKind kind;
+        uint32_t name;
+        size_t bytes;     // 0 until the owner sets it; programs, vertex arrays and framebuffers stay 0
+        std::string site; // owner and purpose, e.g. "SceneRenderer particles"
+    };
+
+    struct Totals {
+        int count = 0;
+        size_t bytes = 0;
+    };
+
+    static void add(GlKind kind, uint32_t name, const char* site);
+    static void setBytes(GlKind kind, uint32_t name, size_t bytes);
+    static void remove(GlKind kind, uint32_t name);
+
+    static Totals totals(GlKind kind);
+    static Totals totals();   // all kinds
+    static size_t peakBytes(); // highest total so far
+    static const char* kindName(GlKind kind);
+
+    // one line per kind that has live objects, then the sum
+    static void printTotals(std::ostream& out);
+
+    // Lists every object still alive, largest first, and returns how many.
+    // Call it after the owners' release() and before the context goes away.
+    static int reportLeaks(std::ostream& out);
+
+private:
+    static std::unordered_map<uint64_t, Entry>& live();
+    static size_t liveBytes, peak;
+};
+
+#endif // GL_REGISTRY_H
@@ -0,0 +1,159 @@
+#include "gpu_emitter.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+#include "noise.h"
+#include "particles.h"
+#include "shader.h"
+
+// velocity damping is tuned per 60 Hz frame, as on the CPU
+static const float FRAME_DT = 1.0f / 60.0f;
+
+GLuint GpuProgramCache::program(const GpuEmitterType& type) {
+    const uint64_t key = programKey(type);
+    auto it = programs.find(key);
+    if (it != programs.end()) return it->second;
+    ++compileCount;
+    return programs.emplace(key, Shader::buildCompute(generateEmitterShader(type).c_str(), "GpuProgramCache emitter kernel"))
+        .first->second;
+}
+
+GLuint GpuProgramCache::noisePermutation() {
+    if (permBuffer) return permBuffer;
+    static_assert(sizeof(noisePerm[0]) == sizeof(GLint), "perm[] is an int array in the kernels");
+    permBuffer.create("GpuProgramCache noise permutation");
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, permBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(noisePerm), noisePerm, GL_STATIC_DRAW);
+    permBuffer.setBytes(sizeof(noisePerm));
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    return permBuffer;
+}
+
+void GpuProgramCache::release() {
+    programs.clear();
+    permBuffer.reset();
+}
+
+// a baked curve as a linearly filtered 1D texture
+static void makeLut(const Curve& curve, GlTexture& tex, const char* site) {
+    std::vector<float> lut = bakeCurve(curve);
+    tex.create(site);
+    glBindTexture(GL_TEXTURE_1D, tex);
+    glTexStorage1D(GL_TEXTURE_1D, 1, GL_R32F, (GLsizei)lut.size());
+    tex.setBytes(glImageBytes(GL_R32F, (int)lut.size()));
+    glTexSubImage1D(GL_TEXTURE_1D, 0, 0, (GLsizei)lut.size(), GL_RED, GL_FLOAT, lut.data());
+    glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_1D, 0);
+}
+
+GpuEmitter::GpuEmitter(const GpuEmitterType& t, GpuProgramCache& c, uint32_t s)
+    : type(t), cache(c), seed(s) {
+    slotCount = type.capacity();
+    program = cache.program(type);
+
+    // every slot starts dead, so the first steps only show what they spawn
+    struct Slot { float posLife[4]; float vel[4]; };
+    std::vector<Slot> init(slotCount, Slot{ { type.pos.x, type.pos.y, type.pos.z, 2.0f }, { 0.0f, 0.0f, 0.0f, 0.0f } });
+    slotBuffer.create("GpuEmitter slots");
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, slotBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(Slot) * slotCount, init.data(), GL_DYNAMIC_COPY);
+    slotBuffer.setBytes(sizeof(Slot) * slotCount);
+    render.create("GpuEmitter render");
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, render);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(GPUParticle) * slotCount, nullptr, GL_DYNAMIC_COPY);
+    render.setBytes(sizeof(GPUParticle) * slotCount);
+    boundsBuffer.create("GpuEmitter bounds");
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, boundsBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(GLuint) * 6, nullptr, GL_DYNAMIC_READ);
+    boundsBuffer.setBytes(sizeof(GLuint) * 6);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    makeLut(type.sizeOverLife, sizeLut, "GpuEmitter size curve");
+    makeLut(type.alphaOverLife, alphaLut, "GpuEmitter alpha curve");
+}
+
+void GpuEmitter::setTrackBounds(bool on) {
+    if (type.trackBounds == on) return;
+    type.trackBounds = on;
+    program = cache.program(type);
+}
+
+void GpuEmitter::update(float dt, float time) {
+    // whole particles due this step; never more than the ring holds
+    spawnTimer += dt * type.spawnRate;
+    const int spawnCount = std::min((int)spawnTimer, slotCount);
+    spawnTimer -= (int)spawnTimer;
+
+    if (type.trackBounds) {
+        // min = all ones, max = 0 in the kernel's ordered encoding
+        const GLuint reset[6] = { ~0u, ~0u, ~0u, 0u, 0u, 0u };
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, boundsBuffer);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(reset), reset);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, boundsBuffer);
+    }
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, slotBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, render);
+    if (type.forces & GPU_FORCE_FLOW) glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, cache.noisePermutation());
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_1D, sizeLut);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_1D, alphaLut);
+    glActiveTexture(GL_TEXTURE0);
+
+    // uniforms a module doesn't use are compiled out; setting them is a no-op
+    glUseProgram(program);
+    auto loc = [&](const char* name) { return glGetUniformLocation(program, name); };
+    glUniform1ui(loc("slotCount"), (GLuint)slotCount);
+    glUniform1ui(loc("spawnFirst"), (GLuint)head);
+    glUniform1ui(loc("spawnCount"), (GLuint)spawnCount);
+    glUniform1ui(loc("seed"), seed * 0x9E3779B9u + step);
+    glUniform1f(loc("dt"), dt);
+    glUniform1f(loc("time"), time);
+    glUniform3f(loc("emitterPos"), type.pos.x, type.pos.y, type.pos.z);
+    glUniform1f(loc("spawnRadius"), type.spawnRadius);
+    glUniform1f(loc("upSpeedMin"), type.upSpeedMin);
+    glUniform1f(loc("upSpeedMax"), type.upSpeedMax);
+    glUniform1f(loc("invLifeSpan"), 1.0f / type.lifeSpan);
+    glUniform1f(loc("sizeBase"), type.sizeBase);
+    glUniform1f(loc("heightBase"), type.pos.y - type.heightOffset);
+    glUniform1f(loc("invSpreadHeight"), 1.0f / type.spreadHeight);
+    glUniform1f(loc("lift"), type.lift);
+    glUniform1f(loc("horizontalSpread"), type.horizontalSpread);
+    glUniform1f(loc("stepDamping"), std::pow(type.dampingPerFrame, dt / FRAME_DT));
+    glUniform1i(loc("sizeLut"), 0);
+    glUniform1i(loc("alphaLut"), 1);
+    glDispatchCompute((slotCount + GPU_EMITTER_GROUP - 1) / GPU_EMITTER_GROUP, 1, 1);
+    // the render buffer is read as vertices, by the splat kernels and by buffer copies
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+
+    head = (head + spawnCount) % slotCount;
+    ++step;
+}
+
+bool GpuEmitter::bounds(glm::vec3& boundsMin, glm::vec3& boundsMax) const {
+    if (!type.trackBounds) return false;
+    GLuint bits[6];
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, boundsBuffer);
+    glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(bits), bits);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    float v[6];
+    for (int c = 0; c < 6; ++c) {
+        uint32_t u = bits[c] & 0x80000000u ? bits[c] & 0x7fffffffu : ~bits[c]; // undo orderedBits()
+        std::memcpy(&v[c], &u, sizeof(float));
+    }
+    boundsMin = glm::vec3(v[0], v[1], v[2]);
+    boundsMax = glm::vec3(v[3], v[4], v[5]);
+    return bits[0] <= bits[3]; // untouched min / max: nothing alive
+}
+
+void GpuEmitter::release() {
+    slotBuffer.reset();
+    render.reset();
+    boundsBuffer.reset();
+    sizeLut.reset();
+    alphaLut.reset();
+}
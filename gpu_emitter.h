@@ -0,0 +1,72 @@
+#ifndef GPU_EMITTER_H
+#define GPU_EMITTER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <unordered_map>
+#include "emitter_codegen.h"
+#include "gl_handles.h"
+
+// ---------- Program cache ----------
+// Generated emitter kernels by programKey(), so every emitter type with the
+// same modules shares one compiled program. Also holds the noise permutation
+// table for the flow module (initNoise() must have run).
+class GpuProgramCache {
+public:
+    // compiles on the first request for this module combination
+    GLuint program(const GpuEmitterType& type);
+
+    GLuint noisePermutation();
+
+    int compiled() const { return compileCount; }
+
+    // call while the context is still current
+    void release();
+
+private:
+    std::unordered_map<uint64_t, GlProgram> programs;
+    GlBuffer permBuffer;
+    int compileCount = 0;
+};
+
+// ---------- GPU emitter ----------
+// One emitter type simulated entirely by its generated kernel. There is one
+// lifetime, so the slots form a ring like PoolLayout::Ring: every step the
+// oldest slots are reborn in place, nothing is compacted, and a dead slot
+// just renders fully transparent until it is reused. Each update writes all
+// slots as GPUParticles into renderBuffer(), ready for
+// SceneRenderer::uploadParticles(GLuint, ...). Construct it only while a
+// GL 4.3+ context is current.
+class GpuEmitter {
+public:
+    GpuEmitter(const GpuEmitterType& type, GpuProgramCache& cache, uint32_t seed = 1);
+
+    void update(float dt, float time);
+
+    // switches the bounds module in or out, i.e. picks another cached program
+    void setTrackBounds(bool on);
+
+    // Bounds of the live particles after the last update, padded by their
+    // size. Reads back from the GPU, so it waits for that update. False if
+    // none are alive or tracking is off.
+    bool bounds(glm::vec3& boundsMin, glm::vec3& boundsMax) const;
+
+    GLuint renderBuffer() const { return render; }
+    int slots() const { return slotCount; }
+
+    // call while the context is still current
+    void release();
+
+private:
+    GpuEmitterType type;
+    GpuProgramCache& cache;
+    GLuint program = 0;
+    GlBuffer slotBuffer, render, boundsBuffer;
+    GlTexture sizeLut, alphaLut;
+    int slotCount = 0, head = 0;
+    float spawnTimer = 0.0f;
+    uint32_t seed, step = 0;
+};
+
+#endif // GPU_EMITTER_H
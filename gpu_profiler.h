@@ -0,0 +1,172 @@
+#ifndef GPU_PROFILER_H
+#define GPU_PROFILER_H
+
+#include <glad/glad.h>
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+// ---------- GPU pass profiler ----------
+// Wraps render passes in GL_TIME_ELAPSED queries. Each frame uses its own set
+// of query objects from a small ring and results are read FRAMES_IN_FLIGHT
+// frames later, so reading them never stalls the pipeline. While disabled no
+// queries exist and begin()/end() return immediately.
+class GpuProfiler {
+public:
+    static const int MAX_PASSES = 16;
+    static const int FRAMES_IN_FLIGHT = 4;
+    static const int HISTORY = 600; // samples kept per pass for the rolling stats
+
+    struct Stats { float minMs, meanMs, p95Ms, p99Ms; int samples; };
+
+    // call while the context is still current
+    void release() {
+        if (created) glDeleteQueries(FRAMES_IN_FLIGHT * MAX_PASSES, &queries[0][0]);
+        created = enabled = false;
+    }
+
+    bool isEnabled() const { return enabled; }
+
+    void setEnabled(bool on) {
+        if (on && !created) {
+            glGenQueries(FRAMES_IN_FLIGHT * MAX_PASSES, &queries[0][0]);
+            created = true;
+        }
+        if (!on) std::memset(issued, 0, sizeof(issued));
+        enabled = on;
+    }
+
+    // collects whatever finished FRAMES_IN_FLIGHT frames ago, then opens this frame's slot
+    void beginFrame() {
+        if (!enabled) return;
+        slot = (slot + 1) % FRAMES_IN_FLIGHT;
+        float total = 0.0f;
+        bool any = false;
+        for (int i = 0; i < passCount; ++i) {
+            if (!issued[slot][i]) continue;
+            issued[slot][i] = false;
+            GLint available = 0;
+            glGetQueryObjectiv(queries[slot][i], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available) { ++droppedSamples; continue; } // never wait on the GPU
+            GLuint64 ns = 0;
+            glGetQueryObjectui64v(queries[slot][i], GL_QUERY_RESULT, &ns);
+            float ms = (float)(ns * 1e-6);
+            push(i, ms);
+            total += ms;
+            any = true;
+        }
+        if (any) lastTotalMs = total;
+    }
+
+    // `name` must outlive the profiler (string literals in practice)
+    void begin(const char* name) {
+        if (!enabled) return;
+        int i = passIndex(name);
+        if (i < 0 || issued[slot][i]) { current = -1; return; }
+        glBeginQuery(GL_TIME_ELAPSED, queries[slot][i]);
+        current = i;
+    }
+
+    void end() {
+        if (!enabled || current < 0) return;
+        glEndQuery(GL_TIME_ELAPSED);
+        issued[slot][current] = true;
+        current = -1;
+    }
+
+    // sum of all passes of the most recently collected frame
+    float lastFrameMs() const { return lastTotalMs; }
+
+    Stats stats(int pass) const {
+        Stats s = { 0.0f, 0.0f, 0.0f, 0.0f, history[pass].count };
+        int n = history[pass].count;
+        if (n == 0) return s;
+        float sorted[HISTORY];
+        std::copy(history[pass].samples, history[pass].samples + n, sorted);
+        std::sort(sorted, sorted + n);
+        float sum = 0.0f;
+        for (int k = 0; k < n; ++k) sum += sorted[k];
+        s.minMs = sorted[0];
+        s.meanMs = sum / n;
+        s.p95Ms = sorted[std::min(n - 1, (int)(n * 0.95f))];
+        s.p99Ms = sorted[std::min(n - 1, (int)(n * 0.99f))];
+        return s;
+    }
+
+    void print(std::ostream& out) const {
+        for (int i = 0; i < passCount; ++i) {
+            Stats s = stats(i);
+            out << "gpu " << names[i] << ": min " << s.minMs << " ms, mean " << s.meanMs
+                << " ms, p95 " << s.p95Ms << " ms, p99 " << s.p99Ms << " ms (" << s.samples << " samples)\n";
+        }
+        if (droppedSamples) out << "gpu profiler: " << droppedSamples << " late results dropped\n";
+    }
+
+    bool writeCsv(const char* path) const {
+        std::ofstream f(path);
+        if (!f) { std::cerr << "Failed to write GPU profile: " << path << "\n"; return false; }
+        f << "pass,min_ms,mean_ms,p95_ms,p99_ms,samples\n";
+        for (int i = 0; i < passCount; ++i) {
+            Stats s = stats(i);
+            f << names[i] << "," << s.minMs << "," << s.meanMs << "," << s.p95Ms << "," << s.p99Ms << "," << s.samples << "\n";
+        }
+        return true;
+    }
+
+    bool writeJson(const char* path) const {
+        std::ofstream f(path);
+        if (!f) { std::cerr << "Failed to write GPU profile: " << path << "\n"; return false; }
+        f << "{\n  \"dropped\": " << droppedSamples << ",\n  \"passes\": [\n";
+        for (int i = 0; i < passCount; ++i) {
+            Stats s = stats(i);
+            f << "    { \"pass\": \"" << names[i] << "\", \"min_ms\": " << s.minMs << ", \"mean_ms\": " << s.meanMs
+              << ", \"p95_ms\": " << s.p95Ms << ", \"p99_ms\": " << s.p99Ms << ", \"samples\": " << s.samples
+              << " }" << (i + 1 < passCount ? "," : "") << "\n";
+        }
+        f << "  ]\n}\n";
+        return true;
+    }
+
+    // RAII helper: GpuProfiler::Scope s(profiler, "smoke");
+    struct Scope {
+        GpuProfiler& p;
+        Scope(GpuProfiler& profiler, const char* name) : p(profiler) { p.begin(name); }
+        ~Scope() { p.end(); }
+    };
+
+private:
+    struct History {
+        float samples[HISTORY];
+        int count = 0, next = 0;
+    };
+
+    GLuint queries[FRAMES_IN_FLIGHT][MAX_PASSES] = {};
+    bool issued[FRAMES_IN_FLIGHT][MAX_PASSES] = {};
+    const char* names[MAX_PASSES] = {};
+    History history[MAX_PASSES];
+    int passCount = 0;
+    int slot = 0;
+    int current = -1;
+    bool enabled = false;
+    bool created = false;
+    float lastTotalMs = 0.0f;
+    long long droppedSamples = 0;
+
+    int passIndex(const char* name) {
+        for (int i = 0; i < passCount; ++i)
+            if (names[i] == name || std::strcmp(names[i], name) == 0) return i;
+        if (passCount == MAX_PASSES) return -1;
+        names[passCount] = name;
+        return passCount++;
+    }
+
+    void push(int pass, float ms) {
+        History& h = history[pass];
+        h.samples[h.next] = ms;
+        h.next = (h.next + 1) % HISTORY;
+        if (h.count < HISTORY) ++h.count;
+    }
+};
+
+#endif // GPU_PROFILER_H
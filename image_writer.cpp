@@ -0,0 +1,136 @@
+#include "image_writer.h"
+#include <cstdio>
+#include <iostream>
+#if SMOKE_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+// ---------- PNG ----------
+#if SMOKE_HAVE_ZLIB
+static void putU32(std::vector<unsigned char>& out, uint32_t v) {
+    out.push_back((unsigned char)(v >> 24));
+    out.push_back((unsigned char)(v >> 16));
+    out.push_back((unsigned char)(v >> 8));
+    out.push_back((unsigned char)v);
+}
+
+// length, type, data, CRC over type + data
+static void putChunk(std::vector<unsigned char>& out, const char* type, const unsigned char* data, size_t bytes) {
+    putU32(out, (uint32_t)bytes);
+    size_t start = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data, data + bytes);
+    putU32(out, (uint32_t)crc32(0, out.data() + start, (uInt)(bytes + 4)));
+}
+#endif
+
+bool writePng(const std::string& path, int width, int height, const unsigned char* rgba) {
+#if SMOKE_HAVE_ZLIB
+    // every row gets the Sub filter: smooth sky and smoke turn into runs of small values
+    const size_t stride = (size_t)width * 4;
+    std::vector<unsigned char> filtered((stride + 1) * height);
+    for (int y = 0; y < height; ++y) {
+        const unsigned char* src = rgba + (size_t)(height - 1 - y) * stride; // PNG stores the top row first
+        unsigned char* dst = &filtered[(stride + 1) * y];
+        dst[0] = 1;
+        for (size_t i = 0; i < stride; ++i) dst[1 + i] = (unsigned char)(src[i] - (i >= 4 ? src[i - 4] : 0));
+    }
+    uLongf packedBytes = compressBound((uLong)filtered.size());
+    std::vector<unsigned char> packed(packedBytes);
+    if (compress2(packed.data(), &packedBytes, filtered.data(), (uLong)filtered.size(), Z_BEST_SPEED) != Z_OK) {
+        std::cerr << "Failed to compress " << path << "\n";
+        return false;
+    }
+
+    static const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    std::vector<unsigned char> png(signature, signature + 8);
+    std::vector<unsigned char> ihdr;
+    putU32(ihdr, (uint32_t)width);
+    putU32(ihdr, (uint32_t)height);
+    ihdr.insert(ihdr.end(), { 8, 6, 0, 0, 0 }); // 8-bit RGBA, deflate, adaptive filters, no interlace
+    putChunk(png, "IHDR", ihdr.data(), ihdr.size());
+    putChunk(png, "IDAT", packed.data(), packedBytes);
+    putChunk(png, "IEND", nullptr, 0);
+
+    FILE* f = std::fopen(path.c_str(), "wb");
+    bool ok = f && std::fwrite(png.data(), 1, png.size(), f) == png.size();
+    if (f && std::fclose(f) != 0) ok = false;
+    if (!ok) std::cerr << "Failed to write " << path << "\n";
+    return ok;
+#else
+    (void)width; (void)height; (void)rgba;
+    std::cerr << "Failed to write " << path << " (PNG needs zlib; built without SMOKE_HAVE_ZLIB)\n";
+    return false;
+#endif
+}
+
+bool writeRaw(const std::string& path, int width, int height, const unsigned char* rgba) {
+    const size_t stride = (size_t)width * 4;
+    FILE* f = std::fopen(path.c_str(), "wb");
+    bool ok = f != nullptr;
+    for (int y = height - 1; ok && y >= 0; --y)
+        ok = std::fwrite(rgba + stride * y, 1, stride, f) == stride;
+    if (f && std::fclose(f) != 0) ok = false;
+    if (!ok) std::cerr << "Failed to write " << path << "\n";
+    return ok;
+}
+
+// ---------- Writer thread ----------
+ImageWriter::ImageWriter(int maxQueued) : maxQueued(maxQueued < 1 ? 1 : (size_t)maxQueued) {
+    worker = std::thread(&ImageWriter::run, this);
+}
+
+ImageWriter::~ImageWriter() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        quit = true;
+    }
+    wake.notify_all();
+    worker.join();
+}
+
+void ImageWriter::push(const std::string& path, int width, int height, std::vector<unsigned char>& rgba, ImageFormat format) {
+    std::unique_lock<std::mutex> lock(mutex);
+    space.wait(lock, [this] { return queue.size() < maxQueued; });
+    queue.push_back({ path, width, height, std::vector<unsigned char>(), format });
+    queue.back().rgba.swap(rgba);
+    lock.unlock();
+    wake.notify_one();
+}
+
+void ImageWriter::finish() {
+    std::unique_lock<std::mutex> lock(mutex);
+    idle.wait(lock, [this] { return queue.empty() && !busy; });
+}
+
+int ImageWriter::written() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return writtenCount;
+}
+
+int ImageWriter::failed() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return failedCount;
+}
+
+void ImageWriter::run() {
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;) {
+        wake.wait(lock, [this] { return quit || !queue.empty(); });
+        if (queue.empty()) return; // quit, and everything is written
+        Job job = std::move(queue.front());
+        queue.pop_front();
+        busy = true;
+        lock.unlock();
+        space.notify_one();
+
+        bool ok = job.format == ImageFormat::Png
+            ? writePng(job.path, job.width, job.height, job.rgba.data())
+            : writeRaw(job.path, job.width, job.height, job.rgba.data());
+
+        lock.lock();
+        busy = false;
+        ++(ok ? writtenCount : failedCount);
+        if (queue.empty()) idle.notify_all();
+    }
+}
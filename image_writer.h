@@ -0,0 +1,59 @@
+#ifndef IMAGE_WRITER_H
+#define IMAGE_WRITER_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// ---------- Image files ----------
+// RGBA8 pixels in GL order (bottom row first) to disk. PNG needs zlib
+// (SMOKE_HAVE_ZLIB); raw files are the bare RGBA8 rows, top row first.
+enum class ImageFormat { Png, Raw };
+
+bool writePng(const std::string& path, int width, int height, const unsigned char* rgba);
+bool writeRaw(const std::string& path, int width, int height, const unsigned char* rgba);
+
+// Encodes and writes images on a background thread so the render loop only
+// hands over its pixel buffer. At most `maxQueued` images wait at a time;
+// push() blocks beyond that rather than letting memory grow.
+class ImageWriter {
+public:
+    explicit ImageWriter(int maxQueued = 8);
+    ~ImageWriter();
+
+    ImageWriter(const ImageWriter&) = delete;
+    ImageWriter& operator=(const ImageWriter&) = delete;
+
+    // takes the contents of `rgba` (it comes back empty)
+    void push(const std::string& path, int width, int height, std::vector<unsigned char>& rgba, ImageFormat format);
+
+    // returns once everything pushed so far is on disk
+    void finish();
+
+    int written() const;
+    int failed() const;
+
+private:
+    struct Job {
+        std::string path;
+        int width, height;
+        std::vector<unsigned char> rgba;
+        ImageFormat format;
+    };
+
+    const size_t maxQueued;
+    mutable std::mutex mutex;
+    std::condition_variable wake, space, idle;
+    std::deque<Job> queue;
+    bool busy = false, quit = false;
+    int writtenCount = 0, failedCount = 0;
+    std::thread worker;
+
+    void run();
+};
+
+#endif // IMAGE_WRITER_H
@@ -0,0 +1,139 @@
+#ifndef LOD_H
+#define LOD_H
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <cstdint>
+#include <cmath>
+#include "particles.h"
+
+// ---------- Screen-space particle LOD ----------
+// Level 0: full textured billboard.
+// Level 1: projected diameter below mergeBelowPx -> merged with its screen-cell
+//          neighbours into one larger, more opaque billboard.
+// Level 2: projected diameter below pointBelowPx -> untextured GL point.
+// Set pointBelowPx to 0 to never use points, or mergeBelowPx == pointBelowPx to never merge.
+struct LodSettings {
+    bool enabled = true;
+    float mergeBelowPx = 4.0f;
+    float pointBelowPx = 1.5f;
+    float mergeCellPx = 12.0f;   // screen cell size that merged particles are binned into
+    float maxMergedAlpha = 0.9f;
+};
+
+struct LodStats {
+    int full = 0;          // level 0 billboards
+    int merged = 0;        // level 1 particles folded into aggregates
+    int mergedSprites = 0; // aggregates actually drawn for them
+    int points = 0;        // level 2 points
+};
+
+class ParticleLod {
+public:
+    LodStats stats;
+
+    explicit ParticleLod(int maxParticles) : points(maxParticles), usedSlots(maxParticles) {
+        int tableSize = 1;
+        while (tableSize < maxParticles * 2) tableSize <<= 1;
+        cells.resize(tableSize);
+    }
+
+    const GPUParticle* pointData() const { return points.data(); }
+
+    // Rewrites `data[0, count)` so that level 0 and merged level 1 billboards come
+    // first and returns their count; level 2 particles go to pointData().
+    // pixelScale = proj[1][1] * viewportHeight / 2, i.e. pixels per unit at depth 1.
+    int apply(const LodSettings& settings, GPUParticle* data, int count, const glm::vec3& camPos,
+              const glm::vec3& forward, const glm::vec3& right, const glm::vec3& up, float pixelScale) {
+        stats = LodStats();
+        if (!settings.enabled) {
+            stats.full = count;
+            return count;
+        }
+
+        ++generation;
+        const float mergePx = settings.mergeBelowPx;
+        const float pointPx = settings.pointBelowPx;
+        const float cellScale = pixelScale / settings.mergeCellPx;
+        const uint32_t mask = (uint32_t)cells.size() - 1;
+        int billboards = 0, nPoints = 0, nCells = 0;
+
+        for (int i = 0; i < count; ++i) {
+            const GPUParticle g = data[i];
+            glm::vec3 d(g.px - camPos.x, g.py - camPos.y, g.pz - camPos.z);
+            float depth = glm::max(glm::dot(d, forward), 1e-3f);
+            float diameterPx = 2.0f * g.size * pixelScale / depth;
+
+            if (diameterPx >= mergePx) {
+                data[billboards++] = g;
+                continue;
+            }
+            if (diameterPx < pointPx) {
+                points[nPoints++] = g;
+                continue;
+            }
+
+            // bin by screen cell and ~9% depth slice
+            int cx = (int)std::floor(glm::dot(d, right) / depth * cellScale);
+            int cy = (int)std::floor(glm::dot(d, up) / depth * cellScale);
+            int cz = (int)std::floor(std::log2(depth) * 8.0f);
+            uint32_t h = ((uint32_t)cx * 73856093u) ^ ((uint32_t)cy * 19349663u) ^ ((uint32_t)cz * 83492791u);
+            for (uint32_t slot = h & mask;; slot = (slot + 1) & mask) {
+                Cell& c = cells[slot];
+                if (c.generation != generation) {
+                    c = Cell();
+                    c.generation = generation;
+                    c.cx = cx; c.cy = cy; c.cz = cz;
+                    usedSlots[nCells++] = slot;
+                }
+                else if (c.cx != cx || c.cy != cy || c.cz != cz) {
+                    continue;
+                }
+                float alpha = 1.0f - g.life;
+                float area = g.size * g.size;
+                c.sumPos += glm::vec3(g.px, g.py, g.pz) * alpha;
+                c.sumPosSq += glm::dot(glm::vec3(g.px, g.py, g.pz), glm::vec3(g.px, g.py, g.pz)) * alpha;
+                c.sumAlpha += alpha;
+                c.opticalDepth += alpha * area;
+                c.maxSize = glm::max(c.maxSize, g.size);
+                break;
+            }
+            ++stats.merged;
+        }
+        stats.full = billboards;
+        stats.points = nPoints;
+
+        // emit one aggregate per occupied cell; aggregates never outnumber their inputs
+        for (int k = 0; k < nCells; ++k) {
+            const Cell& c = cells[usedSlots[k]];
+            if (c.sumAlpha <= 0.0f) continue;
+            glm::vec3 centre = c.sumPos / c.sumAlpha;
+            float spread = std::sqrt(glm::max(c.sumPosSq / c.sumAlpha - glm::dot(centre, centre), 0.0f));
+            float size = glm::max(c.maxSize, spread + c.maxSize * 0.5f);
+            // keep alpha * area (approximate optical depth) of the inputs
+            float alpha = glm::min(c.opticalDepth / (size * size), settings.maxMergedAlpha);
+            // billboard.frag fades alpha as 1 - life, so encode the aggregate's opacity there
+            data[billboards++] = { centre.x, centre.y, centre.z, size, 1.0f - alpha };
+            ++stats.mergedSprites;
+        }
+        return billboards;
+    }
+
+private:
+    struct Cell {
+        uint32_t generation = 0;
+        int cx = 0, cy = 0, cz = 0;
+        glm::vec3 sumPos = glm::vec3(0.0f);
+        float sumPosSq = 0.0f;
+        float sumAlpha = 0.0f;
+        float opticalDepth = 0.0f;
+        float maxSize = 0.0f;
+    };
+
+    std::vector<Cell> cells;          // open-addressed, cleared lazily by generation
+    std::vector<GPUParticle> points;
+    std::vector<uint32_t> usedSlots;  // cells touched this frame, in first-touch order
+    uint32_t generation = 0;
+};
+
+#endif // LOD_H
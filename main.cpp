@@ -6,137 +6,96 @@
 #include <iostream>
 #include <vector>
 #include <cstdlib>
-#include "shader.h"
-#include "chimney.h"
-#include "House.h"
-
-#include "stb_image.h"
-
-
-unsigned int loadTexture(const char* path)
-{
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-
-    int width, height, nrComponents;
-    stbi_set_flip_vertically_on_load(true); //     
-    unsigned char* data = stbi_load(path, &width, &height, &nrComponents, 0);
-    if (data)
-    {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    }
-    else
-    {
-        std::cout << "Failed to load texture at path: " << path << std::endl;
-    }
-    stbi_image_free(data);
-    return textureID;
-}
-
-
-// ---------- Perlin noise ----------
-float fade(float t) { return t * t * t * (t * (t * 6 - 15) + 10); }
-float grad(int hash, float x, float y, float z) {
-    int h = hash & 15;
-    float u = h < 8 ? x : y;
-    float v = h < 4 ? y : (h == 12 || h == 14 ? x : z);
-    return ((h & 1) ? -u : u) + ((h & 2) ? -v : v);
-}
-int p[512];
-void initNoise() {
-    int permutation[] = { 151,160,137,91,90,15,
-        131,13,201,95,96,53,194,233,7,225,140,36,103,30,
-        69,142,8,99,37,240,21,10,23,190,6,148,247,120,
-        234,75,0,26,197,62,94,252,219,203,117,35,11,32,
-        57,177,33,88,237,149,56,87,174,20,125,136,171,
-        168,68,175,74,165,71,134,139,48,27,166,77,146,
-        158,231,83,111,229,122,60,211,133,230,220,105,
-        92,41,55,46,245,40,244,102,143,54,65,25,63,161,
-        1,216,80,73,209,76,132,187,208,89,18,169,200,
-        196,135,130,116,188,159,86,164,100,109,198,173,
-        186,3,64,52,217,226,250,124,123,5,202,38,147,
-        118,126,255,82,85,212,207,206,59,227,47,16,58,
-        17,182,189,28,42,223,183,170,213,119,248,152,
-        2,44,154,163,70,221,153,101,155,167,43,172,9,
-        129,22,39,253,19,98,108,110,79,113,224,232,178,
-        185,112,104,218,246,97,228,251,34,242,193,238,
-        210,144,12,191,179,162,241,81,51,145,235,249,
-        14,239,107,49,192,214,31,181,199,106,157,184,
-        84,204,176,115,121,50,45,127,4,150,254,138,236,
-        205,93,222,114,67,29,24,72,243,141,128,195,78,
-        66,215,61,156,180 };
-    for (int i = 0; i < 256; i++) p[256 + i] = p[i] = permutation[i];
-}
-float perlin(float x, float y, float z) {
-    int X = (int)floor(x) & 255, Y = (int)floor(y) & 255, Z = (int)floor(z) & 255;
-    x -= floor(x); y -= floor(y); z -= floor(z);
-    float u = fade(x), v = fade(y), w = fade(z);
-    int A = p[X] + Y, AA = p[A] + Z, AB = p[A + 1] + Z;
-    int B = p[X + 1] + Y, BA = p[B] + Z, BB = p[B + 1] + Z;
-    float res = glm::mix(glm::mix(glm::mix(grad(p[AA], x, y, z),
-        grad(p[BA], x - 1, y, z), u),
-        glm::mix(grad(p[AB], x, y - 1, z),
-            grad(p[BB], x - 1, y - 1, z), u), v),
-        glm::mix(glm::mix(grad(p[AA + 1], x, y, z - 1),
-            grad(p[BA + 1], x - 1, y, z - 1), u),
-            glm::mix(grad(p[AB + 1], x, y - 1, z - 1),
-                grad(p[BB + 1], x - 1, y - 1, z - 1), u), v), w);
-    return (res + 1.0f) / 2.0f;
-}
-glm::vec3 noiseVelocity(glm::vec3 pos, float time) {
-    float scale = 0.8f;
-    float nX = perlin(pos.x * scale + time * 0.2f, pos.y * scale, pos.z * scale) - 0.5f;
-    float nZ = perlin(pos.z * scale, pos.x * scale + time * 0.3f, pos.y * scale) - 0.5f;
-    return glm::vec3(nX, 0.0f, nZ) * 1.2f;
-}
+#include <cstdio>
+#include <cmath>
+#include <string>
+#include <algorithm>
+#include <fstream>
+#include "noise.h"
+#include "particles.h"
+#include "culling.h"
+#include "lod.h"
+#include "gpu_profiler.h"
+#include "profiler.h"
+#include "renderer.h"
+#include "sim_thread.h"
+#include "budget.h"
+#include "dynamic_resolution.h"
+#include "thread_pool.h"
+#include "particle_stream.h"
+#include "alloc_tracker.h"
+#include "gl_registry.h"
 
-// ---------- Particle ----------
-struct Particle {
-    glm::vec3 pos, vel;
-    float life, size;
-};
 
 // ---------- Tuning ----------
-const int MAX_PARTICLES = 1000;
-const float CHIMNEY_Y = 0.5f;
-const float SPAWN_RADIUS_BASE = 0.03f;
-const float SPAWN_RADIUS_MAX = 0.25f;
-const float UPWARD_SPEED_MIN = 1.0f;
-const float UPWARD_SPEED_MAX = 1.8f;
-const float HORIZONTAL_SPREAD = 0.3f;
-const float LIFE_SPAN = 22.0f;
-const float SIZE_BASE = 0.15f;
-const float SIZE_GROWTH = 1.7f;
+const int MAX_PARTICLES = 1000; // default pool size, --max-particles overrides it
 bool smokeActive = true;
-
-// spread heights
-const float SPREAD_START_HEIGHT = 2.0f;
-const float SPREAD_FULL_HEIGHT = 6.0f;
+CullSettings culling;
+LodSettings lodSettings;
+bool simLodEnabled = false;
+bool simThreaded = false;      // simulate on a separate thread (T / --sim-thread)
+PoolLayout poolLayout = PoolLayout::Compact; // FIFO ring pool instead of compaction (F / --ring)
+int reorderInterval = 60;        // frames between Morton-order sorts of the pool (--reorder N, 0 = never)
+const float PREWARM_STEP = 0.1f; // coarse fixed step of the fast-forward
+float prewarmSeconds = 0.0f;     // emission fast-forwarded at startup and on G (--prewarm S)
+float prewarmMaxMs = 500.0f;     // wall-time cap of one prewarm (--prewarm-ms)
+bool prewarmPending = false;
+std::string statePath = "smoke_state.bin"; // F5 saves / F9 restores the simulation (--state PATH)
+bool saveStatePending = false, loadStatePending = false;
+BudgetSettings budget;         // adapt particle count to a frame-time target (B / --target-ms)
+DynamicResolutionSettings dynamicRes; // adapt render resolution to a GPU-time target (R / --dynamic-res)
+SmokePath smokePath = SmokePath::Raster; // billboards, compute-shader tiles or a raymarched volume (V)
+VolumeSettings volumeSettings;           // grid / steps of the volume path (--volume-res, --volume-steps)
+GpuProfiler gpuProfiler;
+bool showStats = false;
+
+// ---------- Command line ----------
+struct Options {
+    long long traceFirst = -1, traceLast = -1; // --trace-frames A:B
+    std::string traceOut = "trace.json";       // --trace-out path
+    bool simThread = false;                    // --sim-thread
+    bool ring = false;                         // --ring
+    bool persistState = false;                 // --state PATH: restore at startup, save on exit
+    std::string recordPath, playPath;          // --record PATH / --play PATH
+    int maxParticles = MAX_PARTICLES;          // --max-particles N
+    long long allocWarmup = -1;                // --alloc-check N: log allocations after frame N
+};
 
 // ---------- Decl ----------
 void framebuffer_size_callback(GLFWwindow*, int, int);
 void processInput(GLFWwindow*);
-void respawnParticle(Particle&);
+void dumpGpuProfile();
+bool parseOptions(int argc, char** argv, Options& opts);
 
 // ---------- Main ----------
-int main() {
+int main(int argc, char** argv) {
+    Options opts;
+    if (!parseOptions(argc, argv, opts)) return -1;
+    if (opts.traceLast >= 0) {
+#if SMOKE_PROFILE
+        CpuProfiler::captureFrames(opts.traceFirst, opts.traceLast, opts.traceOut);
+        CpuProfiler::setThreadName("main");
+#else
+        std::cerr << "Warning: built with SMOKE_PROFILE=0, --trace-frames ignored\n";
+#endif
+    }
+    AllocTracker::setThreadName("main");
+    if (opts.allocWarmup >= 0) {
+        if (!AllocTracker::enabled()) std::cerr << "Warning: built without SMOKE_ALLOC_TRACKING, --alloc-check ignored\n";
+        AllocTracker::steadyAfter(opts.allocWarmup);
+    }
+
     initNoise();
-    srand((unsigned)time(nullptr));
+
+    // a recording replaces the simulation; the pool and buffers grow to its largest frame
+    ParticlePlayer player;
+    if (!opts.playPath.empty()) {
+        if (!player.open(opts.playPath)) return -1;
+        opts.maxParticles = std::max(opts.maxParticles, player.maxParticles());
+    }
+    ParticleRecorder recorder;
+    if (!opts.recordPath.empty() && !recorder.open(opts.recordPath)) return -1;
+    const bool playing = player.frameCount() > 0;
 
     if (!glfwInit()) return -1;
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
@@ -151,327 +110,450 @@ int main() {
     // load GL functions AFTER context is current
     if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) { std::cerr << "Failed to init GLAD\n"; return -1; }
 
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    glEnable(GL_DEPTH_TEST);
-
-
-    // ----------- GROUND SETUP -----------
-    float groundVertices[] = {
-        // positions          // texcoords
-        -10.0f, 0.0f, -10.0f,  0.0f,  0.0f,
-         10.0f, 0.0f, -10.0f, 10.0f,  0.0f,
-         10.0f, 0.0f,  10.0f, 10.0f, 10.0f,
-        -10.0f, 0.0f,  10.0f,  0.0f, 10.0f
+    SceneRenderer renderer(opts.maxParticles);
+    if (!renderer.valid()) return -1;
+    renderer.volume = volumeSettings;
+    OffscreenTarget offscreen;
+    ResolutionController resolution;
+    if (dynamicRes.enabled) gpuProfiler.setEnabled(true); // its pass timings drive the scale
+
+    // ---------- particle system ----------
+    // one chimney for now; more emitters just take more slices of the same pool
+    // every array is sized for the maximum once; the budget only moves the live cap inside it
+    ParticleSystem smoke(opts.maxParticles, 16, (uint64_t)time(nullptr));
+    smoke.addEmitter(Emitter(), opts.maxParticles);
+    smoke.reorderInterval = reorderInterval;
+    ThreadPool pool;
+    smoke.setThreadPool(&pool); // large pools compact dead particles in parallel
+    std::vector<GPUParticle> gpuData(opts.maxParticles);
+    ParticleLod lod(opts.maxParticles);
+    SimThread simThread(smoke);
+    simThreaded = opts.simThread;
+    if (opts.ring) poolLayout = PoolLayout::Ring;
+    prewarmPending = prewarmSeconds > 0.0f && smokeActive;
+    BudgetController budgetController;
+
+    // ---------- state file ----------
+    float clockOffset = 0.0f; // sim clock = glfwGetTime() + clockOffset, so a restored plume keeps its time
+    auto storeState = [&]() {
+        int64_t t0 = CpuProfiler::nowNs();
+        if (!smoke.saveState(statePath, (float)glfwGetTime() + clockOffset)) return;
+        std::cout << "state: saved " << smoke.liveCount() << " particles to " << statePath << " in "
+            << (CpuProfiler::nowNs() - t0) * 1e-6f << " ms\n";
     };
+    auto restoreState = [&]() {
+        int64_t t0 = CpuProfiler::nowNs();
+        float simTime;
+        if (!smoke.loadState(statePath, &simTime)) return false;
+        clockOffset = simTime - (float)glfwGetTime();
+        poolLayout = smoke.layout();
+        // only the controller lowers the budget; a disabled one would reset it to full on the next frame
+        if (smoke.budget() < budget.maxFraction && !budget.enabled) {
+            budget.enabled = true;
+            std::cout << "state: budget controller on, resuming at " << (int)(smoke.budget() * 100.0f + 0.5f) << "%\n";
+        }
+        budgetController.fraction = smoke.budget();
+        std::cout << "state: restored " << smoke.liveCount() << " particles from " << statePath << " in "
+            << (CpuProfiler::nowNs() - t0) * 1e-6f << " ms\n";
+        return true;
+    };
+    // a restored plume is already developed; the first run of a kiosk has no file yet and prewarms
+    if (opts.persistState && std::ifstream(statePath).good() && restoreState()) prewarmPending = false;
 
-    unsigned int groundIndices[] = { 0, 1, 2, 2, 3, 0 };
-
-    unsigned int groundVAO, groundVBO, groundEBO;
-    glGenVertexArrays(1, &groundVAO);
-    glGenBuffers(1, &groundVBO);
-    glGenBuffers(1, &groundEBO);
-
-    glBindVertexArray(groundVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, groundVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(groundVertices), groundVertices, GL_STATIC_DRAW);
-
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, groundEBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(groundIndices), groundIndices, GL_STATIC_DRAW);
-
-    // position
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-    // texcoords
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
-
-    glBindVertexArray(0);
-
-    
-
-
-    // ---------- SHADERS ----------
-
-    Shader particleShader("billboard.vert", "billboard.frag", "billboard.geom");
-    Shader chimneyShader("chimney.vert", "chimney.frag");
-    
-    Chimney chimney;
-
-    House house("house.png", "roof.jpg");
-    Shader houseShader("house.vert", "house.frag");
-
-    Shader groundShader("ground.vert", "ground.frag");
-    unsigned int grassTexture = loadTexture("grass.jpg");
-
-
-
-    // ---------- load smoke texture ----------
-    int tw, th, tc;
-    stbi_set_flip_vertically_on_load(true);
-    unsigned char* data = stbi_load("smoke.png", &tw, &th, &tc, 4);
-    if (!data) { std::cerr << "Failed to load smoke.png\n"; return -1; }
-    GLuint texSmoke;
-    glGenTextures(1, &texSmoke);
-    glBindTexture(GL_TEXTURE_2D, texSmoke);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, tw, th, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
-    glGenerateMipmap(GL_TEXTURE_2D);
-    stbi_image_free(data);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-    // ---------- load chimney texture ----------
-    int cw, ch, cc;
-    unsigned char* cdata = stbi_load("brick_diffuse.jpg", &cw, &ch, &cc, 0);
-    if (!cdata) {
-        std::cerr << "Warning: Failed to load chimney texture 'brick_diffuse.jpg'. Using solid color.\n";
-    }
-    GLuint texChimney = 0;
-    if (cdata) {
-        glGenTextures(1, &texChimney);
-        glBindTexture(GL_TEXTURE_2D, texChimney);
-        GLenum format = (cc == 4) ? GL_RGBA : GL_RGB;
-        glTexImage2D(GL_TEXTURE_2D, 0, format, cw, ch, 0, format, GL_UNSIGNED_BYTE, cdata);
-        glGenerateMipmap(GL_TEXTURE_2D);
-        stbi_image_free(cdata);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    }
-
-    // ---------- particle GPU buffer ----------
-    struct GPUParticle { float px, py, pz, size, life; };
-    std::vector<Particle> particles;
-    std::vector<GPUParticle> gpuData(MAX_PARTICLES);
-
-    GLuint vao, vbo;
-    glGenVertexArrays(1, &vao);
-    glGenBuffers(1, &vbo);
-    glBindVertexArray(vao);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(GPUParticle) * MAX_PARTICLES, nullptr, GL_STREAM_DRAW);
-
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(GPUParticle), (void*)0);
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 1, GL_FLOAT, GL_FALSE, sizeof(GPUParticle), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, sizeof(GPUParticle), (void*)(4 * sizeof(float)));
-    glBindVertexArray(0);
-
-    glm::mat4 modelIdentity = glm::mat4(1.0f);
-    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 1280.f / 720.f, 0.1f, 100.0f);
     glm::vec3 camPos(0.0f, 2.0f, 6.0f), target(0.0f, 1.0f, 0.0f), worldUp(0.0f, 1.0f, 0.0f);
 
     float lastTime = (float)glfwGetTime();
-    float spawnTimer = 0.0f;
+    float lastStatsTime = lastTime;
 
-    // set chimney shader texture unit
-    chimneyShader.use();
-    chimneyShader.setInt("tex", 0);
+    long long frameIndex = 0;
+    while (!glfwWindowShouldClose(window)) {
+        AllocTracker::beginFrame(frameIndex);
+        CpuProfiler::beginFrame(frameIndex++);
+        PROFILE_ZONE("frame");
+
+        // F5 / F9: the sim thread hands the system back first and takes it again below
+        if (saveStatePending || loadStatePending) {
+            simThread.stop();
+            if (saveStatePending) storeState();
+            if (loadStatePending) restoreState();
+            saveStatePending = loadStatePending = false;
+            lastTime = (float)glfwGetTime();
+        }
 
-    // set smokeTex unit
-    particleShader.use();
-    particleShader.setInt("smokeTex", 0);
+        // fast-forward a developed plume before this frame; its cost stays out of dt
+        if (prewarmPending) {
+            prewarmPending = false;
+            simThread.stop(); // restarted below, from the prewarmed state
+            smoke.setBudget(budgetController.fraction);
+            smoke.setLayout(poolLayout);
+            PrewarmStats warm = smoke.prewarm(prewarmSeconds, PREWARM_STEP, (float)glfwGetTime() + clockOffset, prewarmMaxMs);
+            std::cout << "prewarm: " << warm.simulated << " of " << prewarmSeconds << " s in " << warm.steps
+                << " steps, " << warm.ms << " ms on " << warm.threads << (warm.threads == 1 ? " thread, " : " threads, ")
+                << smoke.liveCount() << " particles";
+            if (warm.simulated < prewarmSeconds) std::cout << " (stopped at the " << prewarmMaxMs << " ms cap)";
+            std::cout << "\n";
+            lastTime = (float)glfwGetTime();
+        }
 
-    while (!glfwWindowShouldClose(window)) {
         float now = (float)glfwGetTime();
         float dt = now - lastTime;
         lastTime = now;
+        float simNow = now + clockOffset;
         processInput(window);
 
-        // --- spawn in puffs ---
-        if (smokeActive) {
-            spawnTimer += dt;
-            if (spawnTimer >= 0.12f) {
-                spawnTimer = 0.0f;
-                int burst = 4; // particles per puff
-                for (int i = 0; i < burst && (int)particles.size() < MAX_PARTICLES; ++i) {
-                    particles.emplace_back();
-                    respawnParticle(particles.back());
-                }
-            }
-        }
-
-        // --- update particles ---
-        for (auto& p : particles) {
-            p.life += dt / LIFE_SPAN;
-            if (p.life >= 1.0f) {
-                respawnParticle(p);
-                continue;
-            }
-
-            // Natural upward drift
-            p.vel += glm::vec3(0.0f, 0.5f * dt, 0.0f);
-
-            // Smooth turbulent motion using Perlin flow
-            glm::vec3 flow = noiseVelocity(p.pos, now);
-            float height = p.pos.y - CHIMNEY_Y;
-            float hFactor = glm::clamp(height / 4.0f, 0.0f, 1.0f);
-
-            // Flow intensity grows with height
-            p.vel += flow * dt * (0.4f + 1.6f * hFactor);
-
-            // Gradual horizontal expansion based on height
-            glm::vec2 radialDir = glm::normalize(glm::vec2(p.pos.x + 1e-6f, p.pos.z + 1e-6f));
-            glm::vec3 radialPush = glm::vec3(radialDir.x, 0.0f, radialDir.y) * HORIZONTAL_SPREAD * hFactor * dt;
-            p.vel += radialPush;
-
-            // Damping and motion integration
-            p.vel *= 0.995f;
-            p.pos += p.vel * dt;
-
-            // Particle size grows with height
-            p.size = SIZE_BASE * (1.0f + (SIZE_GROWTH - 1.0f) * hFactor);
-        }
-
-
-        // prepare GPU data
-        int activeCount = (int)particles.size();
-        for (int i = 0; i < activeCount; ++i) {
-            const auto& p = particles[i];
-            gpuData[i].px = p.pos.x;
-            gpuData[i].py = p.pos.y;
-            gpuData[i].pz = p.pos.z;
-            gpuData[i].size = p.size;
-            gpuData[i].life = p.life;
-        }
-
-        // upload GPU data
-        glBindBuffer(GL_ARRAY_BUFFER, vbo);
-        if (activeCount > 0)
-            glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(GPUParticle) * activeCount, gpuData.data());
-
         // camera basis
         glm::mat4 view = glm::lookAt(camPos, target, worldUp);
         glm::vec3 forward = glm::normalize(target - camPos);
         glm::vec3 right = glm::normalize(glm::cross(forward, worldUp));
         glm::vec3 up = glm::cross(right, forward);
 
-        // --- render: sky, chimney, smoke ---
-        glClearColor(0.55f, 0.75f, 0.95f, 1.0f); 
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-        // ----------- DRAW GROUND -----------
-        groundShader.use();
-        glm::mat4 model = glm::mat4(1.0f);
-        groundShader.setMat4("model", model);
-        groundShader.setMat4("view", view);
-        groundShader.setMat4("projection", projection);
-        groundShader.setInt("texture1", 0);
-
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, grassTexture);
-        glBindVertexArray(groundVAO);
-        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
-
-
-        // --- draw chimney ---
-        chimneyShader.use();
-        glm::mat4 chimneyModel = glm::mat4(1.0f);
-        chimneyModel = glm::translate(chimneyModel, glm::vec3(0.7f, 0.9f, -1.0f));
-        chimneyShader.setMat4("model", chimneyModel);
-
-        chimneyShader.setMat4("view", view);
-        chimneyShader.setMat4("proj", projection);
-
-        // lighting uniforms
-        glm::vec3 lightDir = glm::normalize(glm::vec3(-0.3f, -1.0f, -0.25f));
-        glm::vec3 lightColor = glm::vec3(1.0f, 0.95f, 0.9f);
-        glm::vec3 ambient = glm::vec3(0.35f, 0.35f, 0.4f);
-        chimneyShader.setVec3("lightDir", lightDir);
-        chimneyShader.setVec3("lightColor", lightColor);
-        chimneyShader.setVec3("ambient", ambient);
-
-        if (texChimney != 0) {
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, texChimney);
+        int fbWidth, fbHeight;
+        glfwGetFramebufferSize(window, &fbWidth, &fbHeight);
+        if (fbWidth <= 0 || fbHeight <= 0) {
+            // minimized: sleep until the next event; the wait doesn't count as simulated time
+            glfwWaitEvents();
+            lastTime = (float)glfwGetTime();
+            continue;
         }
-        else {
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, texSmoke);
+        glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)fbWidth / fbHeight, 0.1f, 100.0f);
+
+        // scene resolution: the window's, or a GPU-time driven fraction of it
+        int renderWidth = fbWidth, renderHeight = fbHeight;
+        if (dynamicRes.enabled) {
+            renderWidth = resolution.renderSize(dynamicRes, fbWidth);
+            renderHeight = resolution.renderSize(dynamicRes, fbHeight);
         }
-        // Debug wireframe mode
+        float pixelScale = projection[1][1] * renderHeight * 0.5f; // rendered pixels per unit at depth 1
+
+        SimControl control;
+        control.spawning = smokeActive;
+        control.budget = budgetController.fraction;
+        control.simLod.enabled = simLodEnabled;
+        control.simLod.camPos = camPos;
+        control.simLod.pixelScale = pixelScale;
+        control.layout = poolLayout;
+
+        // the thread takes over the particle system from the next frame on, and hands it back once joined
+        if (simThreaded && !playing && !simThread.running()) simThread.start(simNow, control);
+        if (!simThreaded && simThread.running()) simThread.stop();
+
+        const GPUParticle* packed = gpuData.data();
+        int activeCount;
+        SimLodStats simStats;
+        float simMs;
+        if (playing) {
+            // replay, looped at the recorded pace; decoding stands in for the simulation
+            PROFILE_ZONE("playback");
+            int64_t decodeStart = CpuProfiler::nowNs();
+            float span = player.duration();
+            float t = player.frameTime(0) + (span > 0.0f ? std::fmod(now, span) : 0.0f);
+            packed = player.frame(player.frameAt(t), &activeCount);
+            if (!packed) packed = gpuData.data();
+            simMs = (CpuProfiler::nowNs() - decodeStart) * 1e-6f;
+        }
+        else if (simThread.running()) {
+            // newest complete snapshot; never waits for the simulation
+            PROFILE_ZONE("snapshot");
+            simThread.setControl(control);
+            const SimSnapshot& snap = simThread.latest();
+            packed = snap.particles.data();
+            activeCount = snap.count;
+            simStats = snap.simLodStats;
+            simMs = snap.stepMs;
+        }
+        else {
+            // --- spawn + update particles ---
+            int64_t simStart = CpuProfiler::nowNs();
+            smoke.simLod = control.simLod;
+            smoke.setBudget(control.budget);
+            smoke.setLayout(control.layout);
+            {
+                PROFILE_ZONE("simulate");
+                smoke.update(dt, simNow, control.spawning);
+            }
 
+            // prepare GPU data
+            PROFILE_ZONE("pack");
+            activeCount = smoke.pack(gpuData.data());
+            simStats = smoke.simLodStats;
+            simMs = (CpuProfiler::nowNs() - simStart) * 1e-6f;
+        }
+        if (recorder.isOpen()) {
+            PROFILE_ZONE("record");
+            recorder.addFrame(packed, activeCount, simNow);
+        }
+        int64_t renderStart = CpuProfiler::nowNs();
+
+        // drop particles outside the view before they cost upload and geometry shader work
+        CullStats cullStats;
+        if (culling.enabled) {
+            PROFILE_ZONE("cull");
+            Frustum frustum = Frustum::fromMatrix(projection * view);
+            if (culling.maxDistance > 0.0f)
+                frustum.clampDistance(camPos, forward, culling.maxDistance);
+            activeCount = cullParticles(packed, activeCount, frustum, gpuData.data(), cullStats);
+        }
+        else {
+            // a snapshot is only read, LOD below rewrites gpuData in place
+            if (packed != gpuData.data()) std::copy(packed, packed + activeCount, gpuData.data());
+            cullStats.tested = cullStats.visible = activeCount;
+        }
 
-        chimney.Draw(chimneyShader, chimneyModel);
-        house.Draw(houseShader, view, projection);
+        // merge or point-render particles that only cover a pixel or two
+        int billboardCount;
+        {
+            PROFILE_ZONE("lod");
+            billboardCount = lod.apply(lodSettings, gpuData.data(), activeCount, camPos, forward, right, up, pixelScale);
+        }
+        int pointCount = lod.stats.points;
+
+        if (showStats && now - lastStatsTime >= 1.0f) {
+            lastStatsTime = now;
+            std::cout << "particles: " << cullStats.visible << " visible, "
+                << cullStats.culled << " culled of " << cullStats.tested
+                << " | lod: " << lod.stats.full << " full, " << lod.stats.merged << " merged into "
+                << lod.stats.mergedSprites << ", " << lod.stats.points << " points"
+                << " | sim: " << simStats.updated << " updated";
+            if (simLodEnabled) {
+                std::cout << " (tiers";
+                for (int t = 0; t < SIM_LOD_TIERS; ++t) std::cout << " " << simStats.perTier[t];
+                std::cout << ")";
+            }
+            if (simThread.running())
+                std::cout << " | snapshots: " << simThread.dropped() << " dropped, "
+                    << simThread.duplicated() << " duplicated";
+            if (dynamicRes.enabled)
+                std::cout << " | resolution: " << renderWidth << "x" << renderHeight << " at "
+                    << resolution.smoothedMs << " ms GPU (target " << dynamicRes.targetMs << ")";
+            if (budget.enabled)
+                std::cout << " | budget: " << (int)(budgetController.fraction * 100.0f + 0.5f) << "% at "
+                    << budgetController.smoothedMs << " ms (target " << budget.targetMs << ")";
+            if (AllocTracker::enabled())
+                std::cout << " | allocations: " << AllocTracker::lastFrame().allocations << " last frame, "
+                    << AllocTracker::steadyAllocations() << " steady state";
+            std::cout << "\n";
+        }
 
-        // --- draw smoke---
-        particleShader.use();
-        particleShader.setMat4("model", modelIdentity);
-        particleShader.setMat4("view", view);
-        particleShader.setMat4("proj", projection);
-        particleShader.setVec3("camRight", right);
-        particleShader.setVec3("camUp", up);
-        particleShader.setVec3("tint", glm::vec3(0.95f, 0.95f, 1.0f));
+        // upload GPU data: billboards first, LOD points right after them
+        {
+            PROFILE_ZONE("upload");
+            renderer.smokePath = smokePath;
+            renderer.uploadParticles(gpuData.data(), billboardCount, lod.pointData(), pointCount);
+        }
 
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, texSmoke);
+        {
+            PROFILE_ZONE("render");
+            if (dynamicRes.enabled) {
+                offscreen.resize(fbWidth, fbHeight);
+                offscreen.bind(renderWidth, renderHeight);
+            }
+            else {
+                offscreen.release();
+                glViewport(0, 0, fbWidth, fbHeight);
+            }
+            renderer.draw(view, projection, right, up, pixelScale, gpuProfiler);
+            if (dynamicRes.enabled) offscreen.blitToScreen();
+        }
 
-        glDepthMask(GL_FALSE);
-        glBindVertexArray(vao);
-        if (activeCount > 0)
-            glDrawArrays(GL_POINTS, 0, activeCount);
-        glBindVertexArray(0);
-        glDepthMask(GL_TRUE);
+        // frame work without the vsync wait: CPU submission, or GPU time when it's being measured
+        float renderMs = (CpuProfiler::nowNs() - renderStart) * 1e-6f;
+        if (gpuProfiler.isEnabled()) renderMs = std::max(renderMs, gpuProfiler.lastFrameMs());
+        float workMs = simThread.running() ? std::max(simMs, renderMs) : simMs + renderMs;
+        budgetController.update(budget, workMs, dt);
+        resolution.update(dynamicRes, gpuProfiler.isEnabled() ? gpuProfiler.lastFrameMs() : 0.0f);
 
-        glfwSwapBuffers(window);
+        {
+            PROFILE_ZONE("swap");
+            glfwSwapBuffers(window);
+        }
         glfwPollEvents();
     }
+    simThread.stop();
+    if (opts.persistState) storeState();
+    if (recorder.isOpen()) {
+        int frames = recorder.frames();
+        if (recorder.close())
+            std::cout << "recording: " << frames << " frames, " << recorder.rawBytes() / 1048576.0 << " MB -> "
+                << recorder.fileBytes() / 1048576.0 << " MB in " << opts.recordPath << "\n";
+    }
+    CpuProfiler::finishCapture();
+    if (opts.allocWarmup >= 0) AllocTracker::printReport();
+
+    if (gpuProfiler.isEnabled()) dumpGpuProfile();
+    gpuProfiler.release();
 
-    // cleanup 
-    if (texChimney) glDeleteTextures(1, &texChimney);
-    glDeleteTextures(1, &texSmoke);
-    glDeleteBuffers(1, &vbo);
-    glDeleteVertexArrays(1, &vao);
+    // cleanup; whatever is still registered after this leaked
+    offscreen.release();
+    renderer.release();
+    GlRegistry::reportLeaks(std::cerr);
 
     glfwTerminate();
     return 0;
 }
 
-const float CHIMNEY_BASE_Y = 0.9f;
-const float CHIMNEY_TOP_Y = CHIMNEY_BASE_Y + 0.6f;
-const float CHIMNEY_X = 0.7f;
-const float CHIMNEY_Z = -1.0f;
-
-void respawnParticle(Particle& p) {
-    float angle = (rand() % 1000) / 1000.0f * 2.0f * 3.14159265359f;
-    float r = ((rand() % 1000) / 1000.0f) * SPAWN_RADIUS_BASE;
-    p.pos = glm::vec3(
-        CHIMNEY_X + cos(angle) * r,
-        CHIMNEY_TOP_Y,
-        CHIMNEY_Z + sin(angle) * r
-    );
-    float up = UPWARD_SPEED_MIN + ((rand() % 1000) / 1000.0f) * (UPWARD_SPEED_MAX - UPWARD_SPEED_MIN);
-    p.vel = glm::vec3(((rand() % 1000) / 1000.0f - 0.5f) * 0.02f, up, ((rand() % 1000) / 1000.0f - 0.5f) * 0.02f);
-    p.life = 0.0f;
-    p.size = SIZE_BASE * (0.8f + (rand() % 1000) / 1000.0f * 0.4f);
+// true only on the frame the key goes down
+bool keyPressedOnce(GLFWwindow* window, int key) {
+    static bool wasDown[GLFW_KEY_LAST + 1] = {};
+    bool down = glfwGetKey(window, key) == GLFW_PRESS;
+    bool pressed = down && !wasDown[key];
+    wasDown[key] = down;
+    return pressed;
 }
 
-
 void processInput(GLFWwindow* window) {
     if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
         glfwSetWindowShouldClose(window, true);
 
-    static bool gPressedLast = false;
-    static bool hPressedLast = false;
-
-    bool gPressedNow = glfwGetKey(window, GLFW_KEY_G) == GLFW_PRESS;
-    bool hPressedNow = glfwGetKey(window, GLFW_KEY_H) == GLFW_PRESS;
-
-    if (gPressedNow && !gPressedLast)
+    if (keyPressedOnce(window, GLFW_KEY_G)) {
+        if (!smokeActive && prewarmSeconds > 0.0f) prewarmPending = true;
         smokeActive = true;
+    }
 
-    if (hPressedNow && !hPressedLast)
+    if (keyPressedOnce(window, GLFW_KEY_H))
         smokeActive = false;
 
-    gPressedLast = gPressedNow;
-    hPressedLast = hPressedNow;
+    // C: toggle particle culling, I: print per-second particle stats
+    if (keyPressedOnce(window, GLFW_KEY_C))
+        culling.enabled = !culling.enabled;
+
+    if (keyPressedOnce(window, GLFW_KEY_I))
+        showStats = !showStats;
+
+    // L: toggle screen-space LOD for far particles
+    if (keyPressedOnce(window, GLFW_KEY_L))
+        lodSettings.enabled = !lodSettings.enabled;
+
+    // K: toggle reduced-rate simulation for distant / dispersed particles
+    if (keyPressedOnce(window, GLFW_KEY_K))
+        simLodEnabled = !simLodEnabled;
+
+    // B: hold the frame-time target by scaling particle count and spawn rate
+    if (keyPressedOnce(window, GLFW_KEY_B))
+        budget.enabled = !budget.enabled;
+
+    // R: render the scene at a GPU-time driven fraction of the window resolution
+    if (keyPressedOnce(window, GLFW_KEY_R)) {
+        dynamicRes.enabled = !dynamicRes.enabled;
+        if (dynamicRes.enabled) gpuProfiler.setEnabled(true);
+    }
+
+    // F: switch the particle pool between compaction and a FIFO ring
+    if (keyPressedOnce(window, GLFW_KEY_F))
+        poolLayout = poolLayout == PoolLayout::Ring ? PoolLayout::Compact : PoolLayout::Ring;
+
+    // V: cycle the smoke between billboards, tiled compute splats and the raymarched volume
+    if (keyPressedOnce(window, GLFW_KEY_V))
+        smokePath = smokePath == SmokePath::Raster ? SmokePath::Tiled
+            : smokePath == SmokePath::Tiled ? SmokePath::Volume : SmokePath::Raster;
+
+    // F5: save the simulation state, F9: restore it
+    if (keyPressedOnce(window, GLFW_KEY_F5))
+        saveStatePending = true;
+
+    if (keyPressedOnce(window, GLFW_KEY_F9))
+        loadStatePending = true;
+
+    // T: move the simulation to its own thread / back onto the render thread
+    if (keyPressedOnce(window, GLFW_KEY_T))
+        simThreaded = !simThreaded;
+
+    // P: toggle GPU pass timing, O: write the rolling GPU stats to disk
+    if (keyPressedOnce(window, GLFW_KEY_P))
+        gpuProfiler.setEnabled(!gpuProfiler.isEnabled());
+
+    if (keyPressedOnce(window, GLFW_KEY_O))
+        dumpGpuProfile();
+
+    // M: print the live GL objects and the memory behind them
+    if (keyPressedOnce(window, GLFW_KEY_M))
+        GlRegistry::printTotals(std::cout);
+}
+
+bool parseOptions(int argc, char** argv, Options& opts) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--trace-frames" && hasValue) {
+            if (std::sscanf(argv[++i], "%lld:%lld", &opts.traceFirst, &opts.traceLast) != 2
+                || opts.traceFirst < 0 || opts.traceLast < opts.traceFirst) {
+                std::cerr << "--trace-frames expects FIRST:LAST, e.g. 100:200\n";
+                return false;
+            }
+        }
+        else if (arg == "--trace-out" && hasValue) {
+            opts.traceOut = argv[++i];
+        }
+        else if (arg == "--sim-thread") {
+            opts.simThread = true;
+        }
+        else if (arg == "--ring") {
+            opts.ring = true;
+        }
+        else if (arg == "--max-particles" && hasValue) {
+            opts.maxParticles = std::atoi(argv[++i]);
+            if (opts.maxParticles < 1) { std::cerr << "--max-particles expects a positive count\n"; return false; }
+        }
+        else if (arg == "--dynamic-res" && hasValue) {
+            dynamicRes.targetMs = (float)std::atof(argv[++i]);
+            dynamicRes.enabled = dynamicRes.targetMs > 0.0f;
+            if (!dynamicRes.enabled) { std::cerr << "--dynamic-res expects a positive GPU frame time\n"; return false; }
+        }
+        else if (arg == "--record" && hasValue) {
+            opts.recordPath = argv[++i];
+        }
+        else if (arg == "--play" && hasValue) {
+            opts.playPath = argv[++i];
+        }
+        else if (arg == "--state" && hasValue) {
+            statePath = argv[++i];
+            opts.persistState = true;
+        }
+        else if (arg == "--prewarm" && hasValue) {
+            prewarmSeconds = (float)std::atof(argv[++i]);
+            if (prewarmSeconds < 0.0f) { std::cerr << "--prewarm expects seconds of emission\n"; return false; }
+        }
+        else if (arg == "--prewarm-ms" && hasValue) {
+            prewarmMaxMs = (float)std::atof(argv[++i]);
+            if (prewarmMaxMs < 0.0f) { std::cerr << "--prewarm-ms expects a wall-time cap in ms (0 = none)\n"; return false; }
+        }
+        else if (arg == "--reorder" && hasValue) {
+            reorderInterval = std::atoi(argv[++i]);
+            if (reorderInterval < 0) { std::cerr << "--reorder expects a frame count (0 = never)\n"; return false; }
+        }
+        else if (arg == "--volume-res" && hasValue) {
+            volumeSettings.resolution = std::atoi(argv[++i]);
+            if (volumeSettings.resolution < 2) { std::cerr << "--volume-res expects at least 2 voxels\n"; return false; }
+        }
+        else if (arg == "--volume-steps" && hasValue) {
+            volumeSettings.steps = std::atoi(argv[++i]);
+            if (volumeSettings.steps < 1) { std::cerr << "--volume-steps expects a positive step count\n"; return false; }
+        }
+        else if (arg == "--alloc-check" && hasValue) {
+            opts.allocWarmup = std::atoll(argv[++i]);
+            if (opts.allocWarmup < 0) { std::cerr << "--alloc-check expects a warmup frame count\n"; return false; }
+        }
+        else if (arg == "--target-ms" && hasValue) {
+            budget.targetMs = (float)std::atof(argv[++i]);
+            budget.enabled = budget.targetMs > 0.0f;
+            if (!budget.enabled) { std::cerr << "--target-ms expects a positive frame time\n"; return false; }
+        }
+        else {
+            std::cerr << "Unknown option: " << arg << "\n"
+                << "Usage: " << argv[0] << " [--trace-frames FIRST:LAST] [--trace-out trace.json] [--sim-thread] [--ring]\n"
+                << "       [--max-particles N] [--target-ms MS] [--dynamic-res MS] [--reorder N]\n"
+                << "       [--prewarm S] [--prewarm-ms MS] [--state PATH]\n"
+                << "       [--record PATH] [--play PATH] [--volume-res N] [--volume-steps N] [--alloc-check N]\n";
+            return false;
+        }
+    }
+    return true;
 }
 
+void dumpGpuProfile() {
+    gpuProfiler.print(std::cout);
+    if (gpuProfiler.writeCsv("gpu_profile.csv") && gpuProfiler.writeJson("gpu_profile.json"))
+        std::cout << "GPU profile written to gpu_profile.csv / gpu_profile.json\n";
+}
 
 void framebuffer_size_callback(GLFWwindow*, int width, int height) {
     glViewport(0, 0, width, height);
@@ -0,0 +1,34 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+
+// ---------- Memory-mapped file ----------
+// Read-only view of a whole file. The OS pages it in on first touch, so
+// opening is O(1) and reading costs no copy through a stdio buffer.
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile() { close(); }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // false if the file can't be opened or mapped; an empty file maps to size() 0
+    bool open(const std::string& path);
+    void close();
+
+    const unsigned char* data() const { return (const unsigned char*)view; }
+    size_t size() const { return bytes; }
+
+private:
+    void* view = nullptr;
+    size_t bytes = 0;
+#ifdef _WIN32
+    void* file = nullptr;
+    void* mapping = nullptr;
+#endif
+};
+
+#endif // MAPPED_FILE_H
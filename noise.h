@@ -0,0 +1,98 @@
+#ifndef NOISE_H
+#define NOISE_H
+
+#include <glm/glm.hpp>
+#include <cmath>
+
+// ---------- Perlin noise ----------
+inline float fade(float t) { return t * t * t * (t * (t * 6 - 15) + 10); }
+inline float grad(int hash, float x, float y, float z) {
+    int h = hash & 15;
+    float u = h < 8 ? x : y;
+    float v = h < 4 ? y : (h == 12 || h == 14 ? x : z);
+    return ((h & 1) ? -u : u) + ((h & 2) ? -v : v);
+}
+
+// permutation table, filled by initNoise()
+extern int noisePerm[512];
+void initNoise();
+
+// lerps the eight corner gradients of a lattice cell; h[] are their hashes
+// in the order AA, BA, AB, BB, AA + 1, BA + 1, AB + 1, BB + 1
+inline float perlinCell(const int h[8], float x, float y, float z) {
+    float u = fade(x), v = fade(y), w = fade(z);
+    float res = glm::mix(glm::mix(glm::mix(grad(h[0], x, y, z),
+        grad(h[1], x - 1, y, z), u),
+        glm::mix(grad(h[2], x, y - 1, z),
+            grad(h[3], x - 1, y - 1, z), u), v),
+        glm::mix(glm::mix(grad(h[4], x, y, z - 1),
+            grad(h[5], x - 1, y, z - 1), u),
+            glm::mix(grad(h[6], x, y - 1, z - 1),
+                grad(h[7], x - 1, y - 1, z - 1), u), v), w);
+    return (res + 1.0f) / 2.0f;
+}
+
+inline void perlinHashes(int X, int Y, int Z, int h[8]) {
+    int A = noisePerm[X] + Y, AA = noisePerm[A] + Z, AB = noisePerm[A + 1] + Z;
+    int B = noisePerm[X + 1] + Y, BA = noisePerm[B] + Z, BB = noisePerm[B + 1] + Z;
+    h[0] = noisePerm[AA];
+    h[1] = noisePerm[BA];
+    h[2] = noisePerm[AB];
+    h[3] = noisePerm[BB];
+    h[4] = noisePerm[AA + 1];
+    h[5] = noisePerm[BA + 1];
+    h[6] = noisePerm[AB + 1];
+    h[7] = noisePerm[BB + 1];
+}
+
+// perlin / noiseVelocity stay inline: they sit in the innermost update loop
+inline float perlin(float x, float y, float z) {
+    int X = (int)floor(x) & 255, Y = (int)floor(y) & 255, Z = (int)floor(z) & 255;
+    x -= floor(x); y -= floor(y); z -= floor(z);
+    int h[8];
+    perlinHashes(X, Y, Z, h);
+    return perlinCell(h, x, y, z);
+}
+inline glm::vec3 noiseVelocity(glm::vec3 pos, float time) {
+    float scale = 0.8f;
+    float nX = perlin(pos.x * scale + time * 0.2f, pos.y * scale, pos.z * scale) - 0.5f;
+    float nZ = perlin(pos.z * scale, pos.x * scale + time * 0.3f, pos.y * scale) - 0.5f;
+    return glm::vec3(nX, 0.0f, nZ) * 1.2f;
+}
+
+// ---------- Batched noise ----------
+// Keeps the corner hashes of the last lattice cell a perlin() call landed in.
+// When consecutive calls fall into the same cell, which is the common case
+// once particles are stored in spatial order (ParticleSystem::reorderInterval),
+// the twelve permutation lookups are skipped. Results are bit-identical to the
+// uncached versions.
+struct PerlinCell {
+    int X = -1, Y = -1, Z = -1;
+    int h[8];
+};
+
+inline float perlin(float x, float y, float z, PerlinCell& cell) {
+    int X = (int)floor(x) & 255, Y = (int)floor(y) & 255, Z = (int)floor(z) & 255;
+    x -= floor(x); y -= floor(y); z -= floor(z);
+    if (X != cell.X || Y != cell.Y || Z != cell.Z) {
+        perlinHashes(X, Y, Z, cell.h);
+        cell.X = X;
+        cell.Y = Y;
+        cell.Z = Z;
+    }
+    return perlinCell(cell.h, x, y, z);
+}
+
+// one cell per noiseVelocity component, they sample differently swizzled space
+struct NoiseCache {
+    PerlinCell x, z;
+};
+
+inline glm::vec3 noiseVelocity(glm::vec3 pos, float time, NoiseCache& cache) {
+    float scale = 0.8f;
+    float nX = perlin(pos.x * scale + time * 0.2f, pos.y * scale, pos.z * scale, cache.x) - 0.5f;
+    float nZ = perlin(pos.z * scale, pos.x * scale + time * 0.3f, pos.y * scale, cache.z) - 0.5f;
+    return glm::vec3(nX, 0.0f, nZ) * 1.2f;
+}
+
+#endif // NOISE_H
@@ -1,10 +1,18 @@
 #version 450 core
-layout (location = 0) in vec3 aPos;
+// cheap LOD path: far, sub-pixel particles drawn as untextured points
+layout (location = 0) in vec3 inPos;
+layout (location = 1) in float inSize;
+layout (location = 2) in float inLife; // 0..1 life ratio
+
+out float vLife;
 
-uniform mat4 projection;
 uniform mat4 view;
+uniform mat4 proj;
+uniform float pixelScale; // proj[1][1] * viewport height / 2
 
 void main() {
-    gl_Position = projection * view * vec4(aPos, 1.0);
-    gl_PointSize = 12.0; // temporary particle size
+    vec4 viewPos = view * vec4(inPos, 1.0);
+    vLife = inLife;
+    gl_Position = proj * viewPos;
+    gl_PointSize = max(2.0 * inSize * pixelScale / max(-viewPos.z, 1e-3), 1.0);
 }
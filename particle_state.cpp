@@ -0,0 +1,114 @@
+#include "particles.h"
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <type_traits>
+#include "mapped_file.h"
+
+// ---------- State file ----------
+// Host byte order, written and read as raw structs:
+//   StateHeader
+//   Emitter[emitterCount]   head is always 0 in the file
+//   Particle[liveTotal]     every emitter's live particles in turn, in slice order
+//                           (oldest first unless Morton-reordered)
+// Any change to Particle, Emitter or the header needs a new STATE_VERSION.
+static_assert(std::is_trivially_copyable<Particle>::value, "particles are stored raw");
+static_assert(std::is_trivially_copyable<Emitter>::value, "emitters are stored raw");
+
+static const char STATE_MAGIC[8] = { 'S', 'M', 'O', 'K', 'S', 'T', 'A', 'T' };
+static const uint32_t STATE_VERSION = 3; // 2: Emitter::motion, 3: Particle::lodPhase
+
+struct StateHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t particleBytes;  // sizeof(Particle) / sizeof(Emitter) of the writer
+    uint32_t emitterBytes;
+    uint32_t emitterCount;
+    uint32_t poolSize;       // particles spanned by the emitter slices
+    uint32_t liveTotal;
+    uint64_t rngState;
+    uint32_t frame;
+    uint32_t layout;         // PoolLayout
+    float budget;
+    float simTime;
+};
+
+bool ParticleSystem::saveState(const std::string& path, float simTime) const {
+    StateHeader h;
+    std::memset(&h, 0, sizeof(h));
+    std::memcpy(h.magic, STATE_MAGIC, sizeof(h.magic));
+    h.version = STATE_VERSION;
+    h.particleBytes = sizeof(Particle);
+    h.emitterBytes = sizeof(Emitter);
+    h.emitterCount = (uint32_t)emitters.size();
+    h.poolSize = (uint32_t)used;
+    h.liveTotal = (uint32_t)liveCount();
+    h.rngState = rng.state;
+    h.frame = frame;
+    h.layout = (uint32_t)poolLayout;
+    h.budget = budgetFraction;
+    h.simTime = simTime;
+
+    std::ofstream f(path, std::ios::binary);
+    if (!f) { std::cerr << "Failed to write state: " << path << "\n"; return false; }
+    f.write((const char*)&h, sizeof(h));
+    for (Emitter e : emitters) {
+        e.head = 0; // the particles below are written oldest first
+        f.write((const char*)&e, sizeof(e));
+    }
+    for (const Emitter& e : emitters) {
+        ParticleSpan runs[2];
+        int runCount = spans(e, runs);
+        for (int r = 0; r < runCount; ++r)
+            f.write((const char*)runs[r].data, sizeof(Particle) * runs[r].count);
+    }
+    if (!f) { std::cerr << "Failed to write state: " << path << "\n"; return false; }
+    return true;
+}
+
+bool ParticleSystem::loadState(const std::string& path, float* simTime) {
+    auto fail = [&](const char* why) {
+        std::cerr << "Failed to restore state: " << path << " (" << why << ")\n";
+        return false;
+    };
+    MappedFile file;
+    if (!file.open(path)) return fail("can't open");
+    StateHeader h;
+    if (file.size() < sizeof(h)) return fail("truncated");
+    std::memcpy(&h, file.data(), sizeof(h));
+    if (std::memcmp(h.magic, STATE_MAGIC, sizeof(h.magic)) != 0) return fail("not a state file");
+    if (h.version != STATE_VERSION || h.particleBytes != sizeof(Particle) || h.emitterBytes != sizeof(Emitter))
+        return fail("written by a different version");
+    if (h.poolSize > particles.size()) return fail("particle pool too small");
+    if (h.layout > (uint32_t)PoolLayout::Ring || !(h.budget > 0.0f && h.budget <= 1.0f)) return fail("corrupt header");
+    const size_t expected = sizeof(h) + (size_t)h.emitterCount * sizeof(Emitter) + (size_t)h.liveTotal * sizeof(Particle);
+    if (file.size() != expected) return fail("truncated");
+
+    // validate the whole emitter table before touching anything
+    std::vector<Emitter> table(h.emitterCount);
+    if (h.emitterCount) std::memcpy(table.data(), file.data() + sizeof(h), sizeof(Emitter) * h.emitterCount);
+    int64_t next = 0, live = 0;
+    for (const Emitter& e : table) {
+        if (e.first != next || e.capacity <= 0 || e.count < 0 || e.count > e.capacity || e.head != 0)
+            return fail("corrupt emitter table");
+        next += e.capacity;
+        live += e.count;
+    }
+    if (next != h.poolSize || live != h.liveTotal) return fail("corrupt emitter table");
+
+    // the live runs go straight from the mapping to the front of each slice
+    const unsigned char* src = file.data() + sizeof(h) + sizeof(Emitter) * h.emitterCount;
+    for (const Emitter& e : table) {
+        if (e.count) std::memcpy(&particles[e.first], src, sizeof(Particle) * e.count);
+        src += sizeof(Particle) * e.count;
+    }
+    emitters = std::move(table);
+    used = (int)h.poolSize;
+    rng.state = h.rngState;
+    frame = h.frame;
+    poolLayout = (PoolLayout)h.layout;
+    mortonOrdered.assign(emitters.size(), poolLayout == PoolLayout::Compact); // the writer may have reordered
+    setBudget(h.budget);
+    if (simTime) *simTime = h.simTime;
+    return true;
+}
@@ -0,0 +1,338 @@
+#include "particle_stream.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#if SMOKE_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+// ---------- File layout ----------
+//   StreamHeader
+//   chunk: ChunkHeader + payload, repeated
+//   RecordedFrame[frameCount], RecordedChunk[chunkCount]
+//   StreamFooter
+// Payload (after inflating): per frame a varint count, then per particle a
+// varint reference (0 = the previous particle of this frame, k = the k-th
+// unused particle of the previous frame) and five zigzag varint deltas.
+static const char STREAM_MAGIC[8] = { 'S', 'M', 'O', 'K', 'R', 'E', 'C', '1' };
+static const uint32_t STREAM_VERSION = 1;
+static const uint32_t CODEC_STORED = 0, CODEC_DEFLATE = 1;
+static const int MATCH_WINDOW = 4; // previous-frame slots tried past the last match
+
+struct StreamHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t framesPerChunk;
+    float posStep, sizeStep;
+};
+
+struct ChunkHeader {
+    uint32_t codec;
+    uint32_t rawBytes;
+    uint32_t storedBytes;
+    uint32_t frameCount;
+};
+
+struct StreamFooter {
+    uint64_t indexOffset;
+    uint32_t frameCount;
+    uint32_t chunkCount;
+    uint32_t maxCount;   // largest frame, for sizing playback buffers
+    char magic[8];
+    uint32_t pad;
+};
+
+// ---------- Varints ----------
+static void putVarint(std::vector<uint8_t>& out, uint32_t v) {
+    while (v >= 0x80) {
+        out.push_back((uint8_t)(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back((uint8_t)v);
+}
+
+static bool getVarint(const uint8_t*& p, const uint8_t* end, uint32_t& v) {
+    v = 0;
+    for (int shift = 0; shift < 35 && p < end; shift += 7) {
+        uint8_t b = *p++;
+        v |= (uint32_t)(b & 0x7f) << shift;
+        if (!(b & 0x80)) return true;
+    }
+    return false;
+}
+
+static uint32_t zigzag(int32_t v) { return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31); }
+static int32_t unzigzag(uint32_t v) { return (int32_t)(v >> 1) ^ -(int32_t)(v & 1); }
+
+static QuantizedParticle quantize(const GPUParticle& p, const StreamQuantization& q) {
+    const float invPos = 1.0f / q.posStep;
+    QuantizedParticle r;
+    r.v[0] = (int32_t)std::lround(p.px * invPos);
+    r.v[1] = (int32_t)std::lround(p.py * invPos);
+    r.v[2] = (int32_t)std::lround(p.pz * invPos);
+    r.v[3] = (int32_t)std::lround(p.size / q.sizeStep);
+    r.v[4] = (int32_t)std::lround(glm::clamp(p.life, 0.0f, 1.0f) * 65535.0f);
+    return r;
+}
+
+static GPUParticle dequantize(const QuantizedParticle& r, const StreamQuantization& q) {
+    GPUParticle p;
+    p.px = r.v[0] * q.posStep;
+    p.py = r.v[1] * q.posStep;
+    p.pz = r.v[2] * q.posStep;
+    p.size = r.v[3] * q.sizeStep;
+    p.life = r.v[4] * (1.0f / 65535.0f);
+    return p;
+}
+
+// bytes-ish cost of coding `a` against `ref`
+static uint32_t deltaCost(const QuantizedParticle& a, const QuantizedParticle& ref) {
+    uint32_t cost = 0;
+    for (int k = 0; k < 5; ++k) cost += zigzag(a.v[k] - ref.v[k]);
+    return cost;
+}
+
+// ---------- Recorder ----------
+bool ParticleRecorder::open(const std::string& p, int perChunk, const StreamQuantization& q) {
+    close();
+    file = std::fopen(p.c_str(), "wb");
+    if (!file) { std::cerr << "Failed to write recording: " << p << "\n"; return false; }
+    path = p;
+    quant = q;
+    framesPerChunk = std::max(1, perChunk);
+    chunk.clear();
+    previous.clear();
+    chunkFrames = 0;
+    frameTimes.clear();
+    chunks.clear();
+    maxCount = 0;
+    inputBytes = writtenBytes = 0;
+
+    StreamHeader h;
+    std::memset(&h, 0, sizeof(h));
+    std::memcpy(h.magic, STREAM_MAGIC, sizeof(h.magic));
+    h.version = STREAM_VERSION;
+    h.framesPerChunk = (uint32_t)framesPerChunk;
+    h.posStep = quant.posStep;
+    h.sizeStep = quant.sizeStep;
+    return write(&h, sizeof(h));
+}
+
+bool ParticleRecorder::write(const void* data, size_t bytes) {
+    if (bytes && std::fwrite(data, 1, bytes, file) != bytes) {
+        std::cerr << "Failed to write recording: " << path << "\n";
+        return false;
+    }
+    writtenBytes += bytes;
+    return true;
+}
+
+bool ParticleRecorder::addFrame(const GPUParticle* particles, int count, float time) {
+    if (!file) return false;
+    current.resize(count);
+    for (int i = 0; i < count; ++i) current[i] = quantize(particles[i], quant);
+
+    putVarint(chunk, (uint32_t)count);
+    const int prevCount = (int)previous.size();
+    int next = 0; // first previous-frame particle not matched yet
+    const QuantizedParticle zero = {};
+    for (int i = 0; i < count; ++i) {
+        const QuantizedParticle& q = current[i];
+        const QuantizedParticle* ref = i > 0 ? &current[i - 1] : &zero;
+        uint32_t best = deltaCost(q, *ref), op = 0;
+        for (int k = 0; k < MATCH_WINDOW && next + k < prevCount; ++k) {
+            uint32_t cost = deltaCost(q, previous[next + k]);
+            if (cost < best) { best = cost; op = (uint32_t)k + 1; }
+        }
+        if (op) {
+            ref = &previous[next + op - 1];
+            next += (int)op;
+        }
+        putVarint(chunk, op);
+        for (int k = 0; k < 5; ++k) putVarint(chunk, zigzag(q.v[k] - ref->v[k]));
+    }
+    previous.swap(current);
+
+    frameTimes.push_back({ time, (uint32_t)count });
+    maxCount = std::max(maxCount, (uint32_t)count);
+    inputBytes += sizeof(GPUParticle) * (uint64_t)count;
+    if (++chunkFrames == framesPerChunk) return flushChunk();
+    return true;
+}
+
+bool ParticleRecorder::flushChunk() {
+    if (chunkFrames == 0) return true;
+    ChunkHeader h;
+    h.codec = CODEC_STORED;
+    h.rawBytes = (uint32_t)chunk.size();
+    h.frameCount = (uint32_t)chunkFrames;
+    const uint8_t* payload = chunk.data();
+    size_t payloadBytes = chunk.size();
+#if SMOKE_HAVE_ZLIB
+    uLongf packedBytes = compressBound((uLong)chunk.size());
+    packed.resize(packedBytes);
+    if (compress2(packed.data(), &packedBytes, chunk.data(), (uLong)chunk.size(), Z_BEST_SPEED) == Z_OK
+        && packedBytes < chunk.size()) {
+        h.codec = CODEC_DEFLATE;
+        payload = packed.data();
+        payloadBytes = packedBytes;
+    }
+#endif
+    h.storedBytes = (uint32_t)payloadBytes;
+    chunks.push_back({ writtenBytes, (uint32_t)(frameTimes.size() - chunkFrames), (uint32_t)chunkFrames });
+    bool ok = write(&h, sizeof(h)) && write(payload, payloadBytes);
+
+    // the next chunk codes its first frame without a previous one, so it can be decoded alone
+    chunk.clear();
+    previous.clear();
+    chunkFrames = 0;
+    return ok;
+}
+
+bool ParticleRecorder::close() {
+    if (!file) return true;
+    bool ok = flushChunk();
+    StreamFooter f;
+    std::memset(&f, 0, sizeof(f));
+    f.indexOffset = writtenBytes;
+    f.frameCount = (uint32_t)frameTimes.size();
+    f.chunkCount = (uint32_t)chunks.size();
+    f.maxCount = maxCount;
+    std::memcpy(f.magic, STREAM_MAGIC, sizeof(f.magic));
+    ok = ok && write(frameTimes.data(), sizeof(RecordedFrame) * frameTimes.size())
+        && write(chunks.data(), sizeof(RecordedChunk) * chunks.size())
+        && write(&f, sizeof(f));
+    if (std::fclose(file) != 0) ok = false;
+    file = nullptr;
+    return ok;
+}
+
+// ---------- Player ----------
+bool ParticlePlayer::open(const std::string& path) {
+    auto fail = [&](const char* why) {
+        std::cerr << "Failed to open recording: " << path << " (" << why << ")\n";
+        frames.clear();
+        chunks.clear();
+        return false;
+    };
+    chunkIndex = decoded = -1;
+    if (!file.open(path)) return fail("can't open");
+    StreamHeader h;
+    StreamFooter f;
+    if (file.size() < sizeof(h) + sizeof(f)) return fail("truncated");
+    std::memcpy(&h, file.data(), sizeof(h));
+    std::memcpy(&f, file.data() + file.size() - sizeof(f), sizeof(f));
+    if (std::memcmp(h.magic, STREAM_MAGIC, sizeof(h.magic)) != 0) return fail("not a recording");
+    if (h.version != STREAM_VERSION) return fail("written by a different version");
+    if (std::memcmp(f.magic, STREAM_MAGIC, sizeof(f.magic)) != 0) return fail("no frame index, recording was not closed");
+    const size_t indexBytes = sizeof(RecordedFrame) * (size_t)f.frameCount + sizeof(RecordedChunk) * (size_t)f.chunkCount;
+    if (f.indexOffset < sizeof(h) || f.indexOffset + indexBytes + sizeof(f) != file.size()) return fail("corrupt index");
+
+    quant.posStep = h.posStep;
+    quant.sizeStep = h.sizeStep;
+    maxCount = f.maxCount;
+    frames.resize(f.frameCount);
+    chunks.resize(f.chunkCount);
+    std::memcpy(frames.data(), file.data() + f.indexOffset, sizeof(RecordedFrame) * frames.size());
+    std::memcpy(chunks.data(), file.data() + f.indexOffset + sizeof(RecordedFrame) * frames.size(), sizeof(RecordedChunk) * chunks.size());
+    uint32_t nextFrame = 0;
+    for (const RecordedChunk& c : chunks) {
+        if (c.firstFrame != nextFrame || c.offset + sizeof(ChunkHeader) > f.indexOffset) return fail("corrupt index");
+        nextFrame += c.frameCount;
+    }
+    if (nextFrame != f.frameCount) return fail("corrupt index");
+    for (const RecordedFrame& e : frames)
+        if (e.count > maxCount) return fail("corrupt index");
+    out.resize(maxCount);
+    return true;
+}
+
+int ParticlePlayer::frameAt(float time) const {
+    auto it = std::upper_bound(frames.begin(), frames.end(), time,
+        [](float t, const RecordedFrame& e) { return t < e.time; });
+    return it == frames.begin() ? 0 : (int)(it - frames.begin()) - 1;
+}
+
+bool ParticlePlayer::loadChunk(int c) {
+    const RecordedChunk& entry = chunks[c];
+    ChunkHeader h;
+    std::memcpy(&h, file.data() + entry.offset, sizeof(h));
+    const uint8_t* payload = file.data() + entry.offset + sizeof(h);
+    if (entry.offset + sizeof(h) + h.storedBytes > file.size() || h.frameCount != entry.frameCount) return false;
+    if (h.codec == CODEC_STORED) {
+        // read straight out of the mapping
+        cursor = payload;
+        chunkEnd = payload + h.storedBytes;
+    }
+    else if (h.codec == CODEC_DEFLATE) {
+#if SMOKE_HAVE_ZLIB
+        chunkData.resize(h.rawBytes);
+        uLongf rawBytes = h.rawBytes;
+        if (uncompress(chunkData.data(), &rawBytes, payload, h.storedBytes) != Z_OK || rawBytes != h.rawBytes) return false;
+        cursor = chunkData.data();
+        chunkEnd = cursor + rawBytes;
+#else
+        std::cerr << "Recording needs zlib to play (built without SMOKE_HAVE_ZLIB)\n";
+        return false;
+#endif
+    }
+    else return false;
+    chunkIndex = c;
+    decoded = (int)entry.firstFrame - 1;
+    previous.clear();
+    return true;
+}
+
+bool ParticlePlayer::decodeNext() {
+    uint32_t count;
+    if (!getVarint(cursor, chunkEnd, count) || count != frames[decoded + 1].count) return false;
+    current.resize(count);
+    const int prevCount = (int)previous.size();
+    int next = 0;
+    const QuantizedParticle zero = {};
+    for (uint32_t i = 0; i < count; ++i) {
+        uint32_t op;
+        if (!getVarint(cursor, chunkEnd, op)) return false;
+        const QuantizedParticle* ref = i > 0 ? &current[i - 1] : &zero;
+        if (op) {
+            if (op > (uint32_t)(prevCount - next)) return false;
+            ref = &previous[next + op - 1];
+            next += (int)op;
+        }
+        QuantizedParticle& q = current[i];
+        for (int k = 0; k < 5; ++k) {
+            uint32_t d;
+            if (!getVarint(cursor, chunkEnd, d)) return false;
+            q.v[k] = ref->v[k] + unzigzag(d);
+        }
+    }
+    previous.swap(current);
+    ++decoded;
+    return true;
+}
+
+const GPUParticle* ParticlePlayer::frame(int f, int* count) {
+    *count = 0;
+    if (f < 0 || f >= frameCount()) return nullptr;
+    if (f != decoded) {
+        int c = (int)(std::upper_bound(chunks.begin(), chunks.end(), (uint32_t)f,
+            [](uint32_t frame, const RecordedChunk& e) { return frame < e.firstFrame; }) - chunks.begin()) - 1;
+        if ((c != chunkIndex || f < decoded) && !loadChunk(c)) {
+            std::cerr << "Corrupt recording chunk " << c << "\n";
+            chunkIndex = decoded = -1;
+            return nullptr;
+        }
+        while (decoded < f) {
+            if (!decodeNext()) {
+                std::cerr << "Corrupt recording frame " << decoded + 1 << "\n";
+                chunkIndex = decoded = -1;
+                return nullptr;
+            }
+        }
+    }
+    const int n = (int)previous.size();
+    for (int i = 0; i < n; ++i) out[i] = dequantize(previous[i], quant);
+    *count = n;
+    return out.data();
+}
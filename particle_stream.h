@@ -0,0 +1,107 @@
+#ifndef PARTICLE_STREAM_H
+#define PARTICLE_STREAM_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "mapped_file.h"
+#include "particles.h"
+
+// ---------- Particle recordings ----------
+// A recording is the GPUParticle array of every frame, for replay without
+// the simulation. Positions and sizes are quantized to a fixed grid, life to
+// 16 bits. Each particle is stored as a small delta, either against a particle
+// of the previous frame (packed arrays keep spawn order, so the match is
+// found a few slots ahead of the last one) or against its predecessor in the
+// same frame. The deltas are varints, and every `framesPerChunk` frames form
+// a chunk that is deflated when built with zlib (SMOKE_HAVE_ZLIB). A chunk
+// starts from scratch, so the frame index at the end of the file can seek to
+// any frame by decoding at most one chunk.
+struct StreamQuantization {
+    float posStep = 1.0f / 1024.0f;  // world units
+    float sizeStep = 1.0f / 4096.0f;
+};
+
+// one quantized particle: x, y, z, size, life
+struct QuantizedParticle { int32_t v[5]; };
+
+// frame index entries, stored at the end of the file
+struct RecordedFrame { float time; uint32_t count; };
+struct RecordedChunk { uint64_t offset; uint32_t firstFrame, frameCount; };
+
+class ParticleRecorder {
+public:
+    ParticleRecorder() = default;
+    ~ParticleRecorder() { close(); }
+
+    ParticleRecorder(const ParticleRecorder&) = delete;
+    ParticleRecorder& operator=(const ParticleRecorder&) = delete;
+
+    bool open(const std::string& path, int framesPerChunk = 30, const StreamQuantization& q = StreamQuantization());
+    bool isOpen() const { return file != nullptr; }
+
+    // appends one frame; `time` is what playback paces by
+    bool addFrame(const GPUParticle* particles, int count, float time);
+
+    // flushes the last chunk and writes the frame index; the file is unreadable without it
+    bool close();
+
+    int frames() const { return (int)frameTimes.size(); }
+    uint64_t rawBytes() const { return inputBytes; }   // GPUParticle bytes fed in
+    uint64_t fileBytes() const { return writtenBytes; }
+
+private:
+    FILE* file = nullptr;
+    std::string path;
+    StreamQuantization quant;
+    int framesPerChunk = 30;
+    std::vector<uint8_t> chunk, packed;
+    std::vector<QuantizedParticle> previous, current;
+    int chunkFrames = 0;
+    std::vector<RecordedFrame> frameTimes;
+    std::vector<RecordedChunk> chunks;
+    uint32_t maxCount = 0;
+    uint64_t inputBytes = 0, writtenBytes = 0;
+
+    bool write(const void* data, size_t bytes);
+    bool flushChunk();
+};
+
+class ParticlePlayer {
+public:
+    // maps the file and reads its index
+    bool open(const std::string& path);
+
+    int frameCount() const { return (int)frames.size(); }
+    int maxParticles() const { return (int)maxCount; }
+    float frameTime(int f) const { return frames[f].time; }
+    float duration() const { return frames.empty() ? 0.0f : frames.back().time - frames.front().time; }
+
+    // last frame at or before `time` (recording times, clamped to the ends)
+    int frameAt(float time) const;
+
+    // decodes frame f into an internal buffer. Playing forwards only decodes
+    // the new frames; a seek decodes from the start of f's chunk.
+    const GPUParticle* frame(int f, int* count);
+
+private:
+    MappedFile file;
+    StreamQuantization quant;
+    uint32_t maxCount = 0;
+    std::vector<RecordedFrame> frames;
+    std::vector<RecordedChunk> chunks;
+
+    // decoding position
+    int chunkIndex = -1, decoded = -1;
+    std::vector<uint8_t> chunkData;
+    const uint8_t* cursor = nullptr;
+    const uint8_t* chunkEnd = nullptr;
+    std::vector<QuantizedParticle> previous, current;
+    std::vector<GPUParticle> out;
+
+    bool loadChunk(int c);
+    bool decodeNext();
+};
+
+#endif // PARTICLE_STREAM_H
@@ -0,0 +1,420 @@
+#include "particles.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include "noise.h"
+#include "profiler.h"
+#include "thread_pool.h"
+#include "update_kernel.h"
+
+// velocity damping is tuned per 60 Hz frame; other step sizes apply it step / FRAME_DT times
+static const float DAMPING_PER_FRAME = 0.995f;
+static const float FRAME_DT = 1.0f / 60.0f;
+
+int ParticleSystem::addEmitter(const Emitter& params, int capacity) {
+    if (capacity <= 0 || used + capacity > (int)particles.size()) return -1;
+    Emitter e = params;
+    e.first = used;
+    e.capacity = capacity;
+    e.count = 0;
+    e.spawnTimer = 0.0f;
+    used += capacity;
+    emitters.push_back(e);
+    return (int)emitters.size() - 1;
+}
+
+int ParticleSystem::liveCount() const {
+    int n = 0;
+    for (const Emitter& e : emitters) n += e.count;
+    return n;
+}
+
+void ParticleSystem::update(float dt, float time, bool spawning) {
+    ++frame;
+    simLodStats = SimLodStats();
+    for (uint32_t i = 0; i < (uint32_t)emitters.size(); ++i) {
+        Emitter& e = emitters[i];
+        if (spawning && e.active) spawn(e, i, dt);
+        // retirement over the budget takes the oldest particles, i.e. the front of the slice
+        if (i < mortonOrdered.size() && mortonOrdered[i] && e.count > liveCap(e)) restoreSpawnOrder(i);
+        updateEmitter(e, dt, time);
+        if (poolLayout == PoolLayout::Ring) retireHead(e);
+        else {
+            compact(e);
+            if (reorderInterval > 0 && (frame + i) % (uint32_t)reorderInterval == 0 && e.count <= liveCap(e))
+                reorderSlice(i);
+        }
+    }
+}
+
+PrewarmStats ParticleSystem::prewarm(float seconds, float step, float time, float maxMs) {
+    using Clock = std::chrono::steady_clock;
+    PrewarmStats stats;
+    if (seconds <= 0.0f || step <= 0.0f) return stats;
+    PROFILE_ZONE("prewarm");
+    const Clock::time_point start = Clock::now();
+    const bool lodWas = simLod.enabled;
+    simLod.enabled = false; // coarse steps already cover several frames each
+    widestRun = 1;
+    prewarming = true;
+    const int steps = (int)std::ceil(seconds / step);
+    for (int i = 0; i < steps; ++i) {
+        float t = time - (steps - i - 1) * step;
+        update(step, t, true);
+        ++stats.steps;
+        stats.simulated += step;
+        stats.ms = std::chrono::duration<float, std::milli>(Clock::now() - start).count();
+        if (maxMs > 0.0f && stats.ms >= maxMs) break;
+    }
+    simLod.enabled = lodWas;
+    prewarming = false;
+    stats.threads = widestRun;
+    return stats;
+}
+
+int ParticleSystem::spans(const Emitter& e, ParticleSpan out[2]) const {
+    const Particle* ps = particles.data() + e.first;
+    int firstRun = glm::min(e.count, e.capacity - e.head);
+    out[0] = { ps + e.head, firstRun };
+    if (firstRun == e.count) return 1;
+    out[1] = { ps, e.count - firstRun };
+    return 2;
+}
+
+int ParticleSystem::pack(GPUParticle* out) const {
+    int n = 0;
+    for (const Emitter& e : emitters) {
+        ParticleSpan runs[2];
+        int runCount = spans(e, runs);
+        for (int r = 0; r < runCount; ++r) {
+            const Particle* ps = runs[r].data;
+            for (int i = 0; i < runs[r].count; ++i, ++n) {
+                out[n].px = ps[i].pos.x;
+                out[n].py = ps[i].pos.y;
+                out[n].pz = ps[i].pos.z;
+                out[n].size = ps[i].size;
+                out[n].life = glm::min(ps[i].life, 1.0f); // ring: may overshoot until retired
+            }
+        }
+    }
+    return n;
+}
+
+void ParticleSystem::setLayout(PoolLayout l) {
+    if (l == poolLayout) return;
+    for (uint32_t i = 0; i < (uint32_t)mortonOrdered.size(); ++i)
+        if (mortonOrdered[i]) restoreSpawnOrder(i); // the ring retires from the head
+    for (Emitter& e : emitters) {
+        // a compacted slice is a ring with head 0; a ring is rotated back to start at 0
+        Particle* ps = particles.data() + e.first;
+        std::rotate(ps, ps + e.head, ps + e.capacity);
+        e.head = 0;
+    }
+    poolLayout = l;
+}
+
+void ParticleSystem::setBudget(float fraction) {
+    budgetFraction = glm::clamp(fraction, 1e-3f, 1.0f);
+}
+
+int ParticleSystem::liveCap(const Emitter& e) const {
+    return glm::max(1, (int)(e.capacity * budgetFraction + 0.5f));
+}
+
+void ParticleSystem::setThreadPool(ThreadPool* p) {
+    pool = p;
+    if (pool) {
+        scratch.resize(particles.size());
+        blockOffsets.resize(pool->size() * 4);
+        blockStats.resize(pool->size() * 4);
+    }
+}
+
+void ParticleSystem::compact(Emitter& e) {
+    Particle* ps = particles.data() + e.first;
+    const int n = e.count;
+    if (!pool || pool->size() == 1 || n < PARALLEL_COMPACT_MIN) {
+        int live = 0;
+        for (int i = 0; i < n; ++i) {
+            if (ps[i].life >= 1.0f) continue;
+            if (live != i) ps[live] = ps[i];
+            ++live;
+        }
+        e.count = live;
+        return;
+    }
+
+    // 1) live count per block, 2) exclusive prefix sum -> each block's output offset,
+    // 3) every block scatters its live particles into scratch, 4) copy the dense run back
+    const int blocks = glm::min((int)blockOffsets.size(), n / (PARALLEL_COMPACT_MIN / 4));
+    int* offsets = blockOffsets.data();
+    auto blockBegin = [&](int b, int total) { return (int)((int64_t)total * b / blocks); };
+
+    pool->run(blocks, [&](int b) {
+        PROFILE_ZONE("compact count");
+        int live = 0;
+        for (int i = blockBegin(b, n); i < blockBegin(b + 1, n); ++i) live += ps[i].life < 1.0f;
+        offsets[b] = live;
+    });
+    int total = 0;
+    for (int b = 0; b < blocks; ++b) {
+        int live = offsets[b];
+        offsets[b] = total;
+        total += live;
+    }
+    Particle* out = scratch.data() + e.first;
+    pool->run(blocks, [&](int b) {
+        PROFILE_ZONE("compact scatter");
+        int o = offsets[b];
+        for (int i = blockBegin(b, n); i < blockBegin(b + 1, n); ++i)
+            if (ps[i].life < 1.0f) out[o++] = ps[i];
+    });
+    pool->run(blocks, [&](int b) {
+        PROFILE_ZONE("compact copy");
+        std::copy(out + blockBegin(b, total), out + blockBegin(b + 1, total), ps + blockBegin(b, total));
+    });
+    e.count = total;
+}
+
+// ---------- Spatial order ----------
+// 10 bits per axis, interleaved as ...z1y1x1z0y0x0
+static uint32_t spreadBits(uint32_t v) {
+    v &= 0x3ff;
+    v = (v | (v << 16)) & 0x030000ff;
+    v = (v | (v << 8)) & 0x0300f00f;
+    v = (v | (v << 4)) & 0x030c30c3;
+    v = (v | (v << 2)) & 0x09249249;
+    return v;
+}
+
+// stable LSD radix sort on the 30-bit Morton codes in bits 32..61
+static void sortMortonKeys(std::vector<uint64_t>& keys, std::vector<uint64_t>& temp) {
+    const size_t n = keys.size();
+    temp.resize(n);
+    for (int shift = 32; shift < 62; shift += 10) {
+        size_t start[1025] = {};
+        for (uint64_t k : keys) ++start[((k >> shift) & 0x3ff) + 1];
+        for (int d = 0; d < 1024; ++d) start[d + 1] += start[d];
+        for (uint64_t k : keys) temp[start[(k >> shift) & 0x3ff]++] = k;
+        keys.swap(temp);
+    }
+}
+
+void ParticleSystem::reorder() {
+    if (poolLayout != PoolLayout::Compact) return;
+    for (uint32_t i = 0; i < (uint32_t)emitters.size(); ++i) reorderSlice(i);
+}
+
+void ParticleSystem::reorderSlice(uint32_t index) {
+    const Emitter& e = emitters[index];
+    const int n = e.count;
+    if (n < 2) return;
+    const Particle* ps = particles.data() + e.first;
+    glm::vec3 lo = ps[0].pos, hi = ps[0].pos;
+    for (int k = 1; k < n; ++k) {
+        lo = glm::min(lo, ps[k].pos);
+        hi = glm::max(hi, ps[k].pos);
+    }
+    const glm::vec3 scale = 1023.0f / glm::max(hi - lo, glm::vec3(1e-6f));
+    // room for the full slice up front, so sorts of a growing plume don't reallocate
+    sortKeys.reserve(e.capacity);
+    sortTemp.reserve(e.capacity);
+    sortBuffer.reserve(e.capacity);
+    sortKeys.resize(n);
+    for (int k = 0; k < n; ++k) {
+        glm::vec3 q = glm::clamp((ps[k].pos - lo) * scale, 0.0f, 1023.0f);
+        uint32_t code = spreadBits((uint32_t)q.x) | spreadBits((uint32_t)q.y) << 1 | spreadBits((uint32_t)q.z) << 2;
+        sortKeys[k] = (uint64_t)code << 32 | (uint32_t)k;
+    }
+    sortMortonKeys(sortKeys, sortTemp);
+    permuteSlice(e);
+    if (mortonOrdered.size() < emitters.size()) mortonOrdered.resize(emitters.size(), 0);
+    mortonOrdered[index] = 1;
+}
+
+void ParticleSystem::restoreSpawnOrder(uint32_t index) {
+    const Emitter& e = emitters[index];
+    const int n = e.count;
+    const Particle* ps = particles.data() + e.first;
+    sortKeys.resize(n);
+    for (int k = 0; k < n; ++k) {
+        // seconds since spawn, including time a reduced-rate tier still owes;
+        // positive floats order like their bit patterns, inverted for oldest first
+        float age = ps[k].life / ps[k].invLifeSpan + ps[k].pendingDt;
+        uint32_t bits;
+        std::memcpy(&bits, &age, sizeof(bits));
+        sortKeys[k] = (uint64_t)~bits << 32 | (uint32_t)k;
+    }
+    std::sort(sortKeys.begin(), sortKeys.end());
+    permuteSlice(e);
+    mortonOrdered[index] = 0;
+}
+
+void ParticleSystem::permuteSlice(const Emitter& e) {
+    const int n = e.count;
+    Particle* ps = particles.data() + e.first;
+    sortBuffer.resize(n);
+    for (int k = 0; k < n; ++k) sortBuffer[k] = ps[(uint32_t)sortKeys[k]];
+    std::copy(sortBuffer.begin(), sortBuffer.begin() + n, ps);
+}
+
+void ParticleSystem::spawn(Emitter& e, uint32_t index, float dt) {
+    e.spawnTimer += dt;
+    const float interval = e.spawnInterval / budgetFraction;
+    if (e.spawnTimer < interval) return;
+    // one puff per elapsed interval, so the rate doesn't depend on the step size
+    int puffs = 1;
+    if (interval > 0.0f) {
+        puffs = (int)(e.spawnTimer / interval);
+        e.spawnTimer -= puffs * interval;
+    }
+    else e.spawnTimer = 0.0f;
+    const int cap = liveCap(e);
+    const int spawnCount = puffs * e.burst;
+    Particle* ps = particles.data() + e.first;
+    if (poolLayout == PoolLayout::Ring) {
+        const float invLifeSpan = 1.0f / e.lifeSpan; // one lifetime keeps deaths in FIFO order
+        for (int i = 0; i < spawnCount && e.count < cap; ++i) {
+            int tail = e.head + e.count++;
+            Particle& p = ps[tail < e.capacity ? tail : tail - e.capacity];
+            respawnParticle(p, e, index, rng);
+            p.invLifeSpan = invLifeSpan;
+        }
+        return;
+    }
+    for (int i = 0; i < spawnCount && e.count < cap; ++i)
+        respawnParticle(ps[e.count++], e, index, rng);
+}
+
+int ParticleSystem::simLodTier(const Particle& p, float hFactor) const {
+    glm::vec3 d = p.pos - simLod.camPos;
+    float dist = glm::length(d);
+    int tier = 0;
+    while (tier < SIM_LOD_TIERS - 1 && dist > simLod.tierDistance[tier]) ++tier;
+    if (hFactor >= simLod.dispersedHFactor && tier < SIM_LOD_TIERS - 1) ++tier;
+    if (simLod.pixelScale > 0.0f) {
+        float diameterPx = 2.0f * p.size * simLod.pixelScale / glm::max(dist, 1e-3f);
+        while (tier > 0 && diameterPx > simLod.tierMaxPx[tier - 1]) --tier;
+    }
+    return tier;
+}
+
+void ParticleSystem::updateEmitter(const Emitter& e, float dt, float time) {
+    switch (e.motion) {
+    case EmitterMotion::Calm: updateEmitterWith<CalmKernel>(e, dt, time); break;
+    case EmitterMotion::Jet: updateEmitterWith<JetKernel>(e, dt, time); break;
+    default:
+        // consecutive particles share lattice cells only in spatial order; otherwise the cache just mispredicts
+        if (spatiallyOrdered(e)) updateEmitterWith<PlumeKernel<true>>(e, dt, time);
+        else updateEmitterWith<PlumeKernel<false>>(e, dt, time);
+    }
+}
+
+template <class Kernel>
+void ParticleSystem::updateEmitterWith(const Emitter& e, float dt, float time) {
+    Particle* ps = particles.data() + e.first;
+    if (poolLayout == PoolLayout::Compact) {
+        updateRun<true, Kernel>(e, ps, 0, e.count, 0, dt, time);
+        return;
+    }
+    int firstRun = glm::min(e.count, e.capacity - e.head);
+    updateRun<false, Kernel>(e, ps, e.head, e.head + firstRun, 0, dt, time);
+    updateRun<false, Kernel>(e, ps, 0, e.count - firstRun, firstRun, dt, time);
+}
+
+template <bool RetireDead, class Kernel>
+void ParticleSystem::updateRun(const Emitter& e, Particle* ps, int begin, int end, int oldest, float dt, float time) {
+    const int n = end - begin;
+    if (!pool || pool->size() == 1 || n < PARALLEL_UPDATE_MIN) {
+        updateRange<RetireDead, Kernel>(e, ps, begin, end, oldest, dt, time, simLodStats);
+        return;
+    }
+
+    // particles are independent, so any split gives the serial result
+    const int blocks = glm::min((int)blockStats.size(), n / (PARALLEL_UPDATE_MIN / 4));
+    widestRun = glm::max(widestRun, glm::min(blocks, pool->size()));
+    pool->run(blocks, [&](int b) {
+        PROFILE_ZONE(prewarming ? "prewarm block" : "update block");
+        int lo = begin + (int)((int64_t)n * b / blocks);
+        int hi = begin + (int)((int64_t)n * (b + 1) / blocks);
+        blockStats[b] = SimLodStats();
+        updateRange<RetireDead, Kernel>(e, ps, lo, hi, oldest + lo - begin, dt, time, blockStats[b]);
+    });
+    for (int b = 0; b < blocks; ++b) {
+        simLodStats.updated += blockStats[b].updated;
+        for (int t = 0; t < SIM_LOD_TIERS; ++t) simLodStats.perTier[t] += blockStats[b].perTier[t];
+    }
+}
+
+template <bool RetireDead, class Kernel>
+void ParticleSystem::updateRange(const Emitter& e, Particle* ps, int begin, int end, int oldest, float dt, float time, SimLodStats& stats) {
+    const float invRetire = 1.0f / retireTime;
+    // slices are in spawn order, so over the budget the oldest particles are the ones retired
+    const int retireBelow = e.count - liveCap(e) - oldest + begin;
+    const float heightBase = e.pos.y - e.heightOffset;
+    const float invSpreadHeight = 1.0f / e.spreadHeight;
+    const bool lodOn = simLod.enabled;
+    const float stepDamping = dt == FRAME_DT ? DAMPING_PER_FRAME : std::pow(DAMPING_PER_FRAME, dt / FRAME_DT);
+    KernelContext ctx;
+    ctx.time = time;
+    ctx.origin = glm::vec2(e.pos.x, e.pos.z);
+    ctx.horizontalSpread = e.horizontalSpread;
+    ctx.sizeBase = e.sizeBase;
+    ctx.sizeGrowth = e.sizeGrowth - 1.0f;
+
+    for (int i = begin; i < end; ++i) {
+        Particle& p = ps[i];
+
+        float hFactor = glm::clamp((p.pos.y - heightBase) * invSpreadHeight, 0.0f, 1.0f);
+        float step = dt;
+        float damping = stepDamping;
+        if (lodOn) {
+            int tier = simLodTier(p, hFactor);
+            uint32_t period = 1u << tier;
+            if (((frame + p.lodPhase) & (period - 1)) != 0) {
+                p.pendingDt += dt;
+                continue;
+            }
+            step = dt + p.pendingDt;
+            p.pendingDt = 0.0f;
+            // per-frame damping, applied once for every frame this step covers
+            if (step > dt) damping = std::pow(DAMPING_PER_FRAME, step / FRAME_DT);
+            ++stats.perTier[tier];
+        }
+        ++stats.updated;
+
+        // over the budget: fade out within retireTime
+        p.life += step * (i >= retireBelow ? p.invLifeSpan : glm::max(p.invLifeSpan, invRetire));
+        if (RetireDead && p.life >= 1.0f) continue; // dead, compacted away after the loop
+
+        Kernel::apply(p, ForceStep{ step, hFactor, damping }, ctx);
+    }
+}
+
+void ParticleSystem::retireHead(Emitter& e) {
+    const Particle* ps = particles.data() + e.first;
+    while (e.count > 0 && ps[e.head].life >= 1.0f) {
+        if (++e.head == e.capacity) e.head = 0;
+        --e.count;
+    }
+    if (e.count == 0) e.head = 0;
+}
+
+void respawnParticle(Particle& p, const Emitter& e, uint32_t emitterIndex, Rng& rng) {
+    float angle = rng.uniform() * 2.0f * 3.14159265359f;
+    float r = rng.uniform() * e.spawnRadius;
+    p.pos = glm::vec3(
+        e.pos.x + cos(angle) * r,
+        e.pos.y,
+        e.pos.z + sin(angle) * r
+    );
+    float up = e.upSpeedMin + rng.uniform() * (e.upSpeedMax - e.upSpeedMin);
+    p.vel = glm::vec3((rng.uniform() - 0.5f) * 0.02f, up, (rng.uniform() - 0.5f) * 0.02f);
+    p.life = 0.0f;
+    p.invLifeSpan = 1.0f / (e.lifeSpan * (1.0f + (rng.uniform() * 2.0f - 1.0f) * e.lifeSpanJitter));
+    p.size = e.sizeBase * (0.8f + rng.uniform() * 0.4f);
+    p.emitter = emitterIndex;
+    p.pendingDt = 0.0f;
+    p.lodPhase = (uint32_t)rng.next();
+}
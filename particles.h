@@ -0,0 +1,257 @@
+#ifndef PARTICLES_H
+#define PARTICLES_H
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <cstdint>
+#include <string>
+
+class ThreadPool;
+
+// ---------- Random numbers ----------
+// splitmix64: the whole generator is one 64-bit counter, so a run is fully
+// determined by its seed and the state is trivial to save and restore.
+struct Rng {
+    uint64_t state;
+
+    explicit Rng(uint64_t seed = 0) : state(seed) {}
+
+    uint64_t next() {
+        uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+    // uniform in [0, 1)
+    float uniform() { return (float)(next() >> 40) * (1.0f / 16777216.0f); }
+};
+
+// ---------- Particle ----------
+struct Particle {
+    glm::vec3 pos, vel;
+    float life, size;   // life runs 0 -> 1; the particle dies at 1
+    float invLifeSpan;  // 1 / this particle's lifetime in seconds
+    uint32_t emitter;   // index into ParticleSystem::emitters
+    float pendingDt;  // time skipped by reduced-rate simulation LOD, applied on the next update
+    uint32_t lodPhase; // simulation LOD stagger, drawn at spawn; survives compaction and reordering
+};
+
+// what one particle looks like in the billboard VBO
+struct GPUParticle { float px, py, pz, size, life; };
+
+// ---------- Emitter ----------
+// Which forces move an emitter's particles; each one is a fused update
+// kernel (update_kernel.h), chosen once per emitter and frame.
+enum class EmitterMotion : uint32_t {
+    Plume, // drift, Perlin flow, radial spread, damping, size from height: the chimney
+    Calm,  // the plume without flow: a straight column that still spreads
+    Jet,   // drift and damping only, fixed size: a steam vent
+};
+
+// Spawn and motion parameters of one smoke source. The defaults are the
+// original chimney on top of the house.
+struct Emitter {
+    glm::vec3 pos = glm::vec3(0.7f, 1.5f, -1.0f); // centre of the spawn disc
+    float spawnRadius = 0.03f;
+    float spawnInterval = 0.12f;  // seconds between puffs
+    int burst = 4;                // particles per puff
+    float upSpeedMin = 1.0f;
+    float upSpeedMax = 1.8f;
+    float lifeSpan = 22.0f;
+    float lifeSpanJitter = 0.25f; // each particle lives lifeSpan * [1 - jitter, 1 + jitter]
+    float sizeBase = 0.15f;
+    float sizeGrowth = 1.7f;
+    float horizontalSpread = 0.3f;
+    float spreadHeight = 4.0f;    // rise over which flow and spread reach full strength
+    float heightOffset = 1.0f;    // rise the plume already counts as having at pos.y
+    EmitterMotion motion = EmitterMotion::Plume;
+    bool active = true;
+
+    // slice of the shared pool owned by this emitter: [first, first + capacity)
+    int first = 0, capacity = 0, count = 0;
+    int head = 0;                 // oldest live particle, relative to first (ring layout; 0 otherwise)
+    float spawnTimer = 0.0f;
+};
+
+// up to two contiguous runs of live particles, oldest first
+struct ParticleSpan {
+    const Particle* data;
+    int count;
+};
+
+void respawnParticle(Particle& p, const Emitter& e, uint32_t emitterIndex, Rng& rng);
+
+// ---------- Simulation LOD ----------
+// Tier k updates a particle every 2^k frames with the skipped time folded into
+// one larger step. Particles are staggered by a random phase fixed at spawn, so
+// each frame touches about the same share of every tier and no particle waits
+// more than 2^k - 1 frames, however often it moves to another pool slot.
+const int SIM_LOD_TIERS = 4;
+
+struct SimLodSettings {
+    bool enabled = false;
+    glm::vec3 camPos = glm::vec3(0.0f);
+    float pixelScale = 0.0f;                                   // proj[1][1] * viewport height / 2
+    float tierDistance[SIM_LOD_TIERS - 1] = { 12.0f, 24.0f, 48.0f }; // farther -> tier 1, 2, 3
+    float tierMaxPx[SIM_LOD_TIERS - 1] = { 48.0f, 24.0f, 12.0f };    // larger on screen -> capped below tier 1, 2, 3
+    float dispersedHFactor = 0.95f;                            // fully spread plume drops one tier further
+};
+
+struct SimLodStats {
+    int updated = 0;
+    int perTier[SIM_LOD_TIERS] = {};
+};
+
+// what ParticleSystem::prewarm did
+struct PrewarmStats {
+    int steps = 0;
+    float simulated = 0.0f; // seconds; short of the request if the wall-time cap hit
+    float ms = 0.0f;        // wall time spent
+    int threads = 1;        // most threads one update ran on; 1 while runs stay under PARALLEL_UPDATE_MIN
+};
+
+// ---------- Particle system ----------
+// All emitters share one particle pool. Each emitter owns a contiguous slice
+// of it, so the update runs one tight loop per emitter with that emitter's
+// parameters hoisted out, and packing still yields one buffer / one draw call.
+//
+// Two layouts for the live particles inside a slice:
+// Compact: [first, first + count). Particles that die during an update are
+//          removed by an order-preserving stream compaction at its end.
+// Ring:    [head, head + count) modulo the capacity. With one lifetime for the
+//          whole emitter particles die in spawn order, so births append at the
+//          tail, deaths retire from the head, and the update is a sweep over at
+//          most two spans with no per-particle death test. lifeSpanJitter is
+//          ignored for particles spawned while this layout is active.
+enum class PoolLayout { Compact, Ring };
+
+class ParticleSystem {
+public:
+    std::vector<Particle> particles;
+    std::vector<Emitter> emitters;
+    SimLodSettings simLod;
+    SimLodStats simLodStats;
+    Rng rng;
+
+    explicit ParticleSystem(int maxParticles, int maxEmitters = 16, uint64_t seed = 1) : rng(seed) {
+        particles.resize(maxParticles);
+        emitters.reserve(maxEmitters);
+    }
+
+    // reserves `capacity` particles for the emitter; returns its index or -1 if the pool is full
+    int addEmitter(const Emitter& params, int capacity);
+
+    int liveCount() const;
+
+    void update(float dt, float time, bool spawning);
+
+    // Fast-forwards `seconds` of emission in fixed `step`s, ending at `time`,
+    // so a plume can start out fully developed. Stops early once `maxMs` of
+    // wall time is spent (0 = no cap). Sim LOD is off while it runs.
+    PrewarmStats prewarm(float seconds, float step, float time, float maxMs = 0.0f);
+
+    // Writes the whole simulation state (emitter table with spawn timers, live
+    // particles, RNG, budget, layout and the caller's sim clock) to a versioned
+    // binary file. loadState() maps such a file and copies it into this pool,
+    // which must be at least as large; on any mismatch it reports why and
+    // leaves the system untouched. Both live in particle_state.cpp.
+    bool saveState(const std::string& path, float simTime) const;
+    bool loadState(const std::string& path, float* simTime = nullptr);
+
+    // writes every live particle contiguously into `out`; returns how many were written
+    int pack(GPUParticle* out) const;
+
+    // the emitter's live particles as one or two runs; returns how many runs
+    int spans(const Emitter& e, ParticleSpan out[2]) const;
+
+    // switching rearranges the live particles in place
+    void setLayout(PoolLayout l);
+    PoolLayout layout() const { return poolLayout; }
+
+    // Scales every emitter's live cap and spawn rate by `fraction` (0, 1] without
+    // touching the pool allocation. Above a lowered cap the oldest particles
+    // fade out over retireTime seconds.
+    void setBudget(float fraction);
+    float budget() const { return budgetFraction; }
+    float retireTime = 1.0f;
+
+    // live particles this emitter may have under the current budget
+    int liveCap(const Emitter& e) const;
+
+    // Spreads the update of large slices over `pool` and runs their compaction
+    // as a parallel prefix sum (nullptr = always serial). Allocates the
+    // scratch pool once, here.
+    void setThreadPool(ThreadPool* pool);
+
+    // Compact layout only: every reorderInterval updates (0 = never) each
+    // slice is sorted by the Morton code of its particles' positions, so that
+    // neighbours in memory are neighbours in space and consecutive noise
+    // lookups mostly land in the same lattice cell. Emitters take turns, one
+    // frame apart, to spread the cost. Slices lose their spawn order, which
+    // retirement over the budget and the ring layout rely on; it is restored
+    // from the particles' ages before either needs it.
+    int reorderInterval = 0;
+
+    // sorts every compact slice by Morton code now
+    void reorder();
+
+    // runs shorter than this update serially / slices smaller than this compact serially, in place
+    static const int PARALLEL_UPDATE_MIN = 4096;
+    static const int PARALLEL_COMPACT_MIN = 16384;
+
+private:
+    int used = 0;
+    uint32_t frame = 0;
+    float budgetFraction = 1.0f;
+    PoolLayout poolLayout = PoolLayout::Compact;
+    ThreadPool* pool = nullptr;
+    std::vector<Particle> scratch; // parallel compaction target, same size as the pool
+    std::vector<int> blockOffsets;
+    std::vector<SimLodStats> blockStats;
+    int widestRun = 1; // most threads an update run has used, reset by prewarm()
+    bool prewarming = false; // names the update blocks' profiler zones
+
+    // --- spawn in puffs ---
+    void spawn(Emitter& e, uint32_t index, float dt);
+
+    // 0 = every frame ... SIM_LOD_TIERS - 1 = every 2^(SIM_LOD_TIERS - 1) frames
+    int simLodTier(const Particle& p, float hFactor) const;
+
+    // picks the emitter's kernel, then runs updateEmitterWith
+    void updateEmitter(const Emitter& e, float dt, float time);
+
+    template <class Kernel>
+    void updateEmitterWith(const Emitter& e, float dt, float time);
+
+    // updateRange over ps[begin, end), split into blocks on the pool when it is long enough
+    template <bool RetireDead, class Kernel>
+    void updateRun(const Emitter& e, Particle* ps, int begin, int end, int oldest, float dt, float time);
+
+    // integrates ps[begin, end); `oldest` is the age rank of ps[begin] within the emitter
+    template <bool RetireDead, class Kernel>
+    void updateRange(const Emitter& e, Particle* ps, int begin, int end, int oldest, float dt, float time, SimLodStats& stats);
+
+    // removes dead particles from the emitter's slice, keeping their order
+    void compact(Emitter& e);
+
+    // ring layout: drops expired particles off the head
+    void retireHead(Emitter& e);
+
+    // --- spatial order ---
+    std::vector<uint8_t> mortonOrdered; // per emitter: slice no longer in spawn order
+    std::vector<uint64_t> sortKeys, sortTemp;
+    std::vector<Particle> sortBuffer;
+
+    bool spatiallyOrdered(const Emitter& e) const {
+        size_t i = &e - emitters.data();
+        return i < mortonOrdered.size() && mortonOrdered[i];
+    }
+    void reorderSlice(uint32_t index);
+    // back to oldest first, from each particle's age
+    void restoreSpawnOrder(uint32_t index);
+    // rearranges the slice into the order of the indices in sortKeys' low 32 bits
+    void permuteSlice(const Emitter& e);
+};
+
+#endif // PARTICLES_H
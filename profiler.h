@@ -0,0 +1,163 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// ---------- CPU zone profiler ----------
+// PROFILE_ZONE("name") records the enclosing scope's begin/end time into a
+// per-thread buffer while a capture is running. The hot path takes no lock:
+// each thread only appends to its own preallocated buffer, and the mutex is
+// only touched once per thread (registration) and on export.
+// Build with SMOKE_PROFILE=0 to compile every zone out.
+#ifndef SMOKE_PROFILE
+#define SMOKE_PROFILE 1
+#endif
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#if SMOKE_PROFILE
+#define PROFILE_ZONE(name) CpuProfiler::Zone PROFILE_CONCAT(profileZone_, __LINE__)(name)
+#else
+#define PROFILE_ZONE(name) ((void)0)
+#endif
+
+class CpuProfiler {
+public:
+    static const size_t EVENTS_PER_THREAD = 1 << 16;
+
+    struct Event {
+        const char* name; // must be a string literal / outlive the profiler
+        int64_t beginNs, endNs;
+    };
+
+    struct ThreadBuffer {
+        std::vector<Event> events;
+        std::atomic<size_t> count{ 0 };
+        std::atomic<size_t> dropped{ 0 };
+        uint32_t tid = 0;
+        std::string name;
+    };
+
+    struct Zone {
+        ThreadBuffer* buffer;
+        const char* name;
+        int64_t begin;
+
+        explicit Zone(const char* zoneName) {
+            if (!capturing.load(std::memory_order_relaxed)) { buffer = nullptr; return; }
+            buffer = threadBuffer();
+            name = zoneName;
+            begin = nowNs();
+        }
+        ~Zone() {
+            if (!buffer) return;
+            int64_t end = nowNs();
+            size_t n = buffer->count.load(std::memory_order_relaxed);
+            if (n == buffer->events.size()) { buffer->dropped.fetch_add(1, std::memory_order_relaxed); return; }
+            buffer->events[n] = { name, begin, end };
+            buffer->count.store(n + 1, std::memory_order_release);
+        }
+    };
+
+    static int64_t nowNs() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // labels the calling thread in the exported trace
+    static void setThreadName(const char* name) {
+        ThreadBuffer* b = threadBuffer();
+        std::lock_guard<std::mutex> lock(registryMutex);
+        b->name = name;
+    }
+
+    // capture frames [first, last]; export happens once `last` has finished
+    static void captureFrames(long long first, long long last, const std::string& path) {
+        captureFirst = first;
+        captureLast = last;
+        outputPath = path;
+    }
+
+    // called by the owning loop at the start of every frame
+    static void beginFrame(long long frame) {
+        if (captureLast < 0) return;
+        if (frame == captureFirst) capturing.store(true, std::memory_order_relaxed);
+        if (frame == captureLast + 1) finishCapture();
+    }
+
+    // stops a capture that is still running (e.g. the window was closed early) and writes it
+    static void finishCapture() {
+        if (captureLast < 0) return;
+        capturing.store(false, std::memory_order_relaxed);
+        captureLast = -1;
+        writeChromeTrace(outputPath);
+    }
+
+    // chrome://tracing / Perfetto "X" (complete) events, timestamps in microseconds
+    static bool writeChromeTrace(const std::string& path) {
+        std::ofstream f(path);
+        if (!f) { std::cerr << "Failed to write trace: " << path << "\n"; return false; }
+        std::lock_guard<std::mutex> lock(registryMutex);
+        int64_t origin = INT64_MAX;
+        for (const auto& b : buffers) {
+            size_t n = b->count.load(std::memory_order_acquire);
+            for (size_t i = 0; i < n; ++i) origin = std::min(origin, b->events[i].beginNs);
+        }
+        f << std::fixed << std::setprecision(3) << "{\"traceEvents\":[\n";
+        bool first = true;
+        size_t total = 0, dropped = 0;
+        for (const auto& b : buffers) {
+            if (!b->name.empty()) {
+                f << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << b->tid
+                  << ",\"args\":{\"name\":\"" << b->name << "\"}}";
+                first = false;
+            }
+            size_t n = b->count.load(std::memory_order_acquire);
+            for (size_t i = 0; i < n; ++i) {
+                const Event& e = b->events[i];
+                f << (first ? "" : ",\n") << "{\"name\":\"" << e.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << b->tid
+                  << ",\"ts\":" << (e.beginNs - origin) / 1000.0 << ",\"dur\":" << (e.endNs - e.beginNs) / 1000.0 << "}";
+                first = false;
+            }
+            total += n;
+            dropped += b->dropped.load(std::memory_order_relaxed);
+        }
+        f << "\n]}\n";
+        std::cout << "CPU trace: " << total << " zones across " << buffers.size() << " threads written to " << path;
+        if (dropped) std::cout << " (" << dropped << " dropped, buffer full)";
+        std::cout << "\n";
+        return true;
+    }
+
+private:
+    static inline std::atomic<bool> capturing{ false };
+    static inline long long captureFirst = -1, captureLast = -1;
+    static inline std::string outputPath = "trace.json";
+    static inline std::mutex registryMutex;
+    static inline std::vector<std::unique_ptr<ThreadBuffer>> buffers; // outlive their threads for export
+
+    static ThreadBuffer* threadBuffer() {
+        thread_local ThreadBuffer* mine = nullptr;
+        if (!mine) {
+            auto b = std::make_unique<ThreadBuffer>();
+            b->events.resize(EVENTS_PER_THREAD);
+            std::lock_guard<std::mutex> lock(registryMutex);
+            b->tid = (uint32_t)buffers.size() + 1;
+            mine = b.get();
+            buffers.push_back(std::move(b));
+        }
+        return mine;
+    }
+};
+
+#endif // PROFILER_H
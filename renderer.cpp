@@ -0,0 +1,630 @@
+#include "renderer.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include "stb_image.h"
+
+static void loadTexture(const char* path, GlTexture& textureID, const char* site)
+{
+    int width, height, nrComponents;
+    stbi_set_flip_vertically_on_load(true); // so the texture isn't upside down
+    unsigned char* data = stbi_load(path, &width, &height, &nrComponents, 0);
+    if (data)
+    {
+        GLenum format = glComponentFormat(nrComponents);
+
+        textureID.create(site);
+        glBindTexture(GL_TEXTURE_2D, textureID);
+        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
+        glGenerateMipmap(GL_TEXTURE_2D);
+        textureID.setBytes(glImageBytes(format, width, height, 1, true));
+
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    }
+    else
+    {
+        std::cout << "Failed to load texture at path: " << path << std::endl;
+    }
+    stbi_image_free(data);
+}
+
+SceneRenderer::SceneRenderer(int maxParticles)
+    : particleShader("billboard.vert", "billboard.frag", "billboard.geom"),
+      pointShader("particle.vert", "particle.frag"),
+      chimneyShader("chimney.vert", "chimney.frag"),
+      houseShader("house.vert", "house.frag"),
+      groundShader("ground.vert", "ground.frag"),
+      house("house.png", "roof.jpg"),
+      tiled(maxParticles) {
+    capacity = maxParticles;
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glEnable(GL_DEPTH_TEST);
+
+    // ----------- GROUND SETUP -----------
+    float groundVertices[] = {
+        // positions          // texcoords
+        -10.0f, 0.0f, -10.0f,  0.0f,  0.0f,
+         10.0f, 0.0f, -10.0f, 10.0f,  0.0f,
+         10.0f, 0.0f,  10.0f, 10.0f, 10.0f,
+        -10.0f, 0.0f,  10.0f,  0.0f, 10.0f
+    };
+
+    unsigned int groundIndices[] = { 0, 1, 2, 2, 3, 0 };
+
+    groundVAO.create("SceneRenderer ground");
+    groundVBO.create("SceneRenderer ground vertices");
+    groundEBO.create("SceneRenderer ground indices");
+
+    glBindVertexArray(groundVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, groundVBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(groundVertices), groundVertices, GL_STATIC_DRAW);
+    groundVBO.setBytes(sizeof(groundVertices));
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, groundEBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(groundIndices), groundIndices, GL_STATIC_DRAW);
+    groundEBO.setBytes(sizeof(groundIndices));
+
+    // position
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    // texcoords
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
+    glEnableVertexAttribArray(1);
+
+    glBindVertexArray(0);
+
+    loadTexture("grass.jpg", grassTexture, "SceneRenderer grass.jpg");
+
+    // ---------- load smoke texture ----------
+    int tw, th, tc;
+    stbi_set_flip_vertically_on_load(true);
+    unsigned char* data = stbi_load("smoke.png", &tw, &th, &tc, 4);
+    if (!data) { std::cerr << "Failed to load smoke.png\n"; return; }
+    texSmoke.create("SceneRenderer smoke.png");
+    glBindTexture(GL_TEXTURE_2D, texSmoke);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, tw, th, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
+    glGenerateMipmap(GL_TEXTURE_2D);
+    texSmoke.setBytes(glImageBytes(GL_RGBA, tw, th, 1, true));
+    // what the volume path shades with: mean coverage, colour weighted by alpha
+    glm::vec3 colorSum(0.0f);
+    float alphaSum = 0.0f;
+    for (int i = 0; i < tw * th; ++i) {
+        const unsigned char* t = data + i * 4;
+        colorSum += glm::vec3(t[0], t[1], t[2]) * (t[3] / 255.0f);
+        alphaSum += t[3] / 255.0f;
+    }
+    if (alphaSum > 0.0f) smokeMean = glm::vec4(colorSum / (alphaSum * 255.0f), alphaSum / (tw * th));
+    stbi_image_free(data);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    // ---------- load chimney texture ----------
+    int cw, ch, cc;
+    unsigned char* cdata = stbi_load("brick_diffuse.jpg", &cw, &ch, &cc, 0);
+    if (!cdata) {
+        std::cerr << "Warning: Failed to load chimney texture 'brick_diffuse.jpg'. Using solid color.\n";
+    }
+    if (cdata) {
+        texChimney.create("SceneRenderer brick_diffuse.jpg");
+        glBindTexture(GL_TEXTURE_2D, texChimney);
+        GLenum format = glComponentFormat(cc);
+        glTexImage2D(GL_TEXTURE_2D, 0, format, cw, ch, 0, format, GL_UNSIGNED_BYTE, cdata);
+        glGenerateMipmap(GL_TEXTURE_2D);
+        texChimney.setBytes(glImageBytes(format, cw, ch, 1, true));
+        stbi_image_free(cdata);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    }
+
+    // ---------- particle buffer ----------
+    vao.create("SceneRenderer particles");
+    vbo.create("SceneRenderer particles");
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(GPUParticle) * maxParticles, nullptr, GL_STREAM_DRAW);
+    vbo.setBytes(sizeof(GPUParticle) * maxParticles);
+
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(GPUParticle), (void*)0);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 1, GL_FLOAT, GL_FALSE, sizeof(GPUParticle), (void*)(3 * sizeof(float)));
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, sizeof(GPUParticle), (void*)(4 * sizeof(float)));
+    glBindVertexArray(0);
+
+    // set chimney shader texture unit
+    chimneyShader.use();
+    chimneyShader.setInt("tex", 0);
+
+    // set smokeTex unit
+    particleShader.use();
+    particleShader.setInt("smokeTex", 0);
+}
+
+void SceneRenderer::uploadParticles(const GPUParticle* billboards, int numBillboards, const GPUParticle* points, int numPoints) {
+    billboardCount = numBillboards;
+    pointCount = numPoints;
+    if (smokePath == SmokePath::Volume && billboardCount > 0) {
+        boundsMin = glm::vec3(1e30f);
+        boundsMax = glm::vec3(-1e30f);
+        for (int i = 0; i < billboardCount; ++i) {
+            const GPUParticle& p = billboards[i];
+            glm::vec3 pos(p.px, p.py, p.pz);
+            boundsMin = glm::min(boundsMin, pos - glm::vec3(p.size));
+            boundsMax = glm::max(boundsMax, pos + glm::vec3(p.size));
+        }
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    if (billboardCount > 0)
+        glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(GPUParticle) * billboardCount, billboards);
+    if (pointCount > 0)
+        glBufferSubData(GL_ARRAY_BUFFER, sizeof(GPUParticle) * billboardCount,
+            sizeof(GPUParticle) * pointCount, points);
+}
+
+void SceneRenderer::uploadParticles(GLuint billboards, int numBillboards, glm::vec3 billboardsMin, glm::vec3 billboardsMax) {
+    billboardCount = std::min(numBillboards, capacity);
+    pointCount = 0;
+    boundsMin = billboardsMin;
+    boundsMax = billboardsMax;
+    if (billboardCount == 0) return;
+    glBindBuffer(GL_COPY_READ_BUFFER, billboards);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, vbo);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, sizeof(GPUParticle) * billboardCount);
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+void SceneRenderer::draw(const glm::mat4& view, const glm::mat4& projection, glm::vec3 camRight, glm::vec3 camUp,
+    float pixelScale, GpuProfiler& profiler) {
+    // --- render: sky, chimney, smoke ---
+    glClearColor(0.55f, 0.75f, 0.95f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    profiler.beginFrame();
+
+    // ----------- DRAW GROUND -----------
+    profiler.begin("ground");
+    groundShader.use();
+    glm::mat4 model = glm::mat4(1.0f);
+    groundShader.setMat4("model", model);
+    groundShader.setMat4("view", view);
+    groundShader.setMat4("projection", projection);
+    groundShader.setInt("texture1", 0);
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, grassTexture);
+    glBindVertexArray(groundVAO);
+    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+    glBindVertexArray(0);
+    profiler.end();
+
+    // --- draw chimney ---
+    profiler.begin("chimney");
+    chimneyShader.use();
+    glm::mat4 chimneyModel = glm::mat4(1.0f);
+    chimneyModel = glm::translate(chimneyModel, glm::vec3(0.7f, 0.9f, -1.0f));
+    chimneyShader.setMat4("model", chimneyModel);
+
+    chimneyShader.setMat4("view", view);
+    chimneyShader.setMat4("proj", projection);
+
+    // lighting uniforms
+    glm::vec3 lightDir = glm::normalize(glm::vec3(-0.3f, -1.0f, -0.25f));
+    glm::vec3 lightColor = glm::vec3(1.0f, 0.95f, 0.9f);
+    glm::vec3 ambient = glm::vec3(0.35f, 0.35f, 0.4f);
+    chimneyShader.setVec3("lightDir", lightDir);
+    chimneyShader.setVec3("lightColor", lightColor);
+    chimneyShader.setVec3("ambient", ambient);
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, texChimney != 0 ? texChimney : texSmoke);
+
+    chimney.Draw(chimneyShader, chimneyModel);
+    profiler.end();
+
+    profiler.begin("house");
+    house.Draw(houseShader, view, projection);
+    profiler.end();
+
+    // --- draw smoke---
+    profiler.begin("smoke");
+    drawSmoke(view, projection, camRight, camUp, pixelScale);
+    profiler.end();
+}
+
+void SceneRenderer::drawSmoke(const glm::mat4& view, const glm::mat4& projection, glm::vec3 camRight, glm::vec3 camUp,
+    float pixelScale) {
+    const glm::vec3 tint(0.95f, 0.95f, 1.0f);
+    if (smokePath == SmokePath::Tiled && billboardCount > 0)
+        tiled.draw(vbo, billboardCount, view, projection, texSmoke, tint);
+    if (smokePath == SmokePath::Volume && billboardCount > 0)
+        volumeSplatter.draw(vbo, billboardCount, boundsMin, boundsMax, volume, view, projection,
+            glm::mix(glm::vec3(1.0f), tint, 0.2f) * glm::vec3(smokeMean), smokeMean.a);
+
+    glDepthMask(GL_FALSE);
+    glBindVertexArray(vao);
+    if (smokePath == SmokePath::Raster && billboardCount > 0) {
+        particleShader.use();
+        particleShader.setMat4("model", glm::mat4(1.0f));
+        particleShader.setMat4("view", view);
+        particleShader.setMat4("proj", projection);
+        particleShader.setVec3("camRight", camRight);
+        particleShader.setVec3("camUp", camUp);
+        particleShader.setVec3("tint", tint);
+
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, texSmoke);
+        glDrawArrays(GL_POINTS, 0, billboardCount);
+    }
+
+    if (pointCount > 0) {
+        pointShader.use();
+        pointShader.setMat4("view", view);
+        pointShader.setMat4("proj", projection);
+        pointShader.setFloat("pixelScale", pixelScale);
+        pointShader.setVec3("tint", tint);
+        glEnable(GL_PROGRAM_POINT_SIZE);
+        glDrawArrays(GL_POINTS, billboardCount, pointCount);
+        glDisable(GL_PROGRAM_POINT_SIZE);
+    }
+    glBindVertexArray(0);
+    glDepthMask(GL_TRUE);
+}
+
+void SceneRenderer::release() {
+    texChimney.reset();
+    texSmoke.reset();
+    grassTexture.reset();
+    vbo.reset();
+    vao.reset();
+    groundVBO.reset();
+    groundEBO.reset();
+    groundVAO.reset();
+    particleShader.release();
+    pointShader.release();
+    chimneyShader.release();
+    houseShader.release();
+    groundShader.release();
+    chimney.release();
+    house.release();
+    tiled.release();
+    volumeSplatter.release();
+}
+
+TiledSplatter::TiledSplatter(int maxParticles)
+    : binShader("splat_bin.comp"),
+      sortShader("splat_sort.comp"),
+      compositeShader("splat_composite.comp"),
+      blitShader("splat_blit.vert", "splat_blit.frag") {
+    // 2 x vec4 per particle, written by the bin pass
+    splatBuffer.create("TiledSplatter splats");
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, splatBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, (GLsizeiptr)maxParticles * 32, nullptr, GL_DYNAMIC_COPY);
+    splatBuffer.setBytes((size_t)maxParticles * 32);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    blitVao.create("TiledSplatter blit"); // core profile draws need one, even without attributes
+
+    compositeShader.use();
+    compositeShader.setInt("smokeTex", 0);
+    blitShader.use();
+    blitShader.setInt("smokeImage", 0);
+}
+
+void TiledSplatter::resize(int w, int h) {
+    if (w == width && h == height && image) return;
+    width = w;
+    height = h;
+    tilesX = (w + TILE_SIZE - 1) / TILE_SIZE;
+    tilesY = (h + TILE_SIZE - 1) / TILE_SIZE;
+    const int tiles = tilesX * tilesY;
+
+    // create() replaces the previous size's objects
+    countBuffer.create("TiledSplatter tile counts");
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, countBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(GLuint) * (tiles + 1), nullptr, GL_DYNAMIC_COPY);
+    countBuffer.setBytes(sizeof(GLuint) * (tiles + 1));
+    listBuffer.create("TiledSplatter tile lists");
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, listBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(GLuint) * tiles * TILE_CAPACITY, nullptr, GL_DYNAMIC_COPY);
+    listBuffer.setBytes(sizeof(GLuint) * tiles * TILE_CAPACITY);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    image.create("TiledSplatter image");
+    glBindTexture(GL_TEXTURE_2D, image);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA16F, w, h);
+    image.setBytes(glImageBytes(GL_RGBA16F, w, h));
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+}
+
+void TiledSplatter::draw(GLuint particles, int count, const glm::mat4& view, const glm::mat4& projection,
+    GLuint smokeTexture, glm::vec3 tint) {
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    resize(viewport[2], viewport[3]);
+    const glm::ivec2 size(width, height), grid(tilesX, tilesY);
+
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 0, particles, 0, sizeof(GPUParticle) * count);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, splatBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, countBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, listBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, countBuffer);
+    glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    // 1) bin
+    binShader.use();
+    binShader.setMat4("view", view);
+    binShader.setMat4("proj", projection);
+    binShader.setIVec2("viewportSize", size);
+    binShader.setIVec2("tileGrid", grid);
+    binShader.setInt("particleCount", count);
+    glDispatchCompute((count + 255) / 256, 1, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    // 2) sort every tile's list
+    sortShader.use();
+    glDispatchCompute(tilesX * tilesY, 1, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    // 3) composite front to back
+    compositeShader.use();
+    compositeShader.setVec3("tint", tint);
+    compositeShader.setIVec2("viewportSize", size);
+    compositeShader.setIVec2("tileGrid", grid);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, smokeTexture);
+    glBindImageTexture(0, image, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+    glDispatchCompute(tilesX, tilesY, 1);
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+    // premultiplied smoke over the scene
+    blitShader.use();
+    blitShader.setIVec2("viewportOrigin", glm::ivec2(viewport[0], viewport[1]));
+    glBindTexture(GL_TEXTURE_2D, image);
+    glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    glDisable(GL_DEPTH_TEST);
+    glDepthMask(GL_FALSE);
+    glBindVertexArray(blitVao);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindVertexArray(0);
+    glDepthMask(GL_TRUE);
+    glEnable(GL_DEPTH_TEST);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+}
+
+int TiledSplatter::overflow() const {
+    if (!countBuffer) return 0;
+    GLuint dropped = 0;
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, countBuffer);
+    glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, sizeof(GLuint) * tilesX * tilesY, sizeof(GLuint), &dropped);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    return (int)dropped;
+}
+
+void TiledSplatter::release() {
+    image.reset();
+    splatBuffer.reset();
+    countBuffer.reset();
+    listBuffer.reset();
+    blitVao.reset();
+    binShader.release();
+    sortShader.release();
+    compositeShader.release();
+    blitShader.release();
+    width = height = 0;
+}
+
+void OffscreenTarget::resize(int w, int h) {
+    if (w == width && h == height && fbo) return;
+    release();
+    width = w;
+    height = h;
+    color.create("OffscreenTarget colour");
+    glBindRenderbuffer(GL_RENDERBUFFER, color);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    color.setBytes(glImageBytes(GL_RGBA8, width, height));
+    depth.create("OffscreenTarget depth");
+    glBindRenderbuffer(GL_RENDERBUFFER, depth);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+    depth.setBytes(glImageBytes(GL_DEPTH24_STENCIL8, width, height));
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    fbo.create("OffscreenTarget");
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depth);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cerr << "Offscreen framebuffer incomplete (" << width << "x" << height << ")\n";
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void OffscreenTarget::bind(int w, int h) {
+    renderWidth = glm::min(w, width);
+    renderHeight = glm::min(h, height);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glViewport(0, 0, renderWidth, renderHeight);
+}
+
+void OffscreenTarget::blitToScreen() {
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+    glBlitFramebuffer(0, 0, renderWidth, renderHeight, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, width, height);
+}
+
+void OffscreenTarget::release() {
+    fbo.reset();
+    color.reset();
+    depth.reset();
+    width = height = 0;
+}
+
+PixelReadback::PixelReadback(int depth) : slots(depth < 1 ? 1 : depth) {}
+
+bool PixelReadback::read(GLuint fbo, int w, int h, uint64_t tag) {
+    if (pending == (int)slots.size()) return false;
+    Slot& s = slots[(oldest + pending) % slots.size()];
+    const size_t bytes = (size_t)w * h * 4;
+    if (!s.pbo) s.pbo.create("PixelReadback");
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, s.pbo);
+    if (s.capacity != bytes) {
+        glBufferData(GL_PIXEL_PACK_BUFFER, bytes, nullptr, GL_STREAM_READ);
+        s.pbo.setBytes(bytes);
+        s.capacity = bytes;
+    }
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, w, h, GL_RGBA, GL_UNSIGNED_BYTE, nullptr); // into the PBO, returns at once
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    s.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    glFlush(); // without a swap nothing else submits the fence; flushing doesn't wait
+    s.width = w;
+    s.height = h;
+    s.tag = tag;
+    ++pending;
+    return true;
+}
+
+bool PixelReadback::collect(std::vector<unsigned char>& rgba, int* w, int* h, uint64_t* tag, bool wait) {
+    if (pending == 0) return false;
+    Slot& s = slots[oldest];
+    GLenum status = glClientWaitSync(s.fence, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0, wait ? GL_TIMEOUT_IGNORED : 0);
+    if (status == GL_TIMEOUT_EXPIRED) return false;
+    glDeleteSync(s.fence);
+    s.fence = nullptr;
+    oldest = (oldest + 1) % (int)slots.size();
+    --pending;
+    if (status == GL_WAIT_FAILED) {
+        std::cerr << "Pixel readback fence failed, frame " << s.tag << " dropped\n";
+        return false;
+    }
+
+    const size_t bytes = (size_t)s.width * s.height * 4;
+    rgba.resize(bytes);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, s.pbo);
+    const void* mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, bytes, GL_MAP_READ_BIT);
+    if (mapped) std::memcpy(rgba.data(), mapped, bytes);
+    glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    *w = s.width;
+    *h = s.height;
+    *tag = s.tag;
+    return mapped != nullptr;
+}
+
+void PixelReadback::release() {
+    for (Slot& s : slots) {
+        if (s.fence) glDeleteSync(s.fence);
+        s = Slot(); // deletes the PBO
+    }
+    oldest = pending = 0;
+}
+
+VolumeSplatter::VolumeSplatter()
+    : splatShader("volume_splat.comp"),
+      resolveShader("volume_resolve.comp"),
+      raymarchShader("splat_blit.vert", "volume_raymarch.frag") {
+    blitVao.create("VolumeSplatter blit");
+    raymarchShader.use();
+    raymarchShader.setInt("extinction", 0);
+}
+
+void VolumeSplatter::resize(int r) {
+    if (r == resolution && density) return;
+    resolution = r;
+    // a cube: the bounds change every frame, the allocation doesn't
+    density.create("VolumeSplatter density");
+    glBindTexture(GL_TEXTURE_3D, density);
+    glTexStorage3D(GL_TEXTURE_3D, 1, GL_R32UI, r, r, r);
+    density.setBytes(glImageBytes(GL_R32UI, r, r, r));
+    extinction.create("VolumeSplatter extinction");
+    glBindTexture(GL_TEXTURE_3D, extinction);
+    glTexStorage3D(GL_TEXTURE_3D, 1, GL_R16F, r, r, r);
+    extinction.setBytes(glImageBytes(GL_R16F, r, r, r));
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+}
+
+void VolumeSplatter::draw(GLuint particles, int count, glm::vec3 boundsMin, glm::vec3 boundsMax,
+    const VolumeSettings& settings, const glm::mat4& view, const glm::mat4& projection, glm::vec3 color, float coverage) {
+    resize(glm::max(settings.resolution, 2));
+    glm::vec3 extent = glm::max(boundsMax - boundsMin, glm::vec3(1e-3f));
+    float voxelSize = glm::max(extent.x, glm::max(extent.y, extent.z)) / resolution;
+    glm::ivec3 used(glm::min((int)std::ceil(extent.x / voxelSize), resolution),
+        glm::min((int)std::ceil(extent.y / voxelSize), resolution), glm::min((int)std::ceil(extent.z / voxelSize), resolution));
+    const GLuint zero = 0;
+    glClearTexImage(density, 0, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+
+    // 1) splat
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 0, particles, 0, sizeof(GPUParticle) * count);
+    glBindImageTexture(0, density, 0, GL_TRUE, 0, GL_READ_WRITE, GL_R32UI);
+    splatShader.use();
+    splatShader.setInt("particleCount", count);
+    splatShader.setVec3("gridMin", boundsMin);
+    splatShader.setFloat("voxelSize", voxelSize);
+    splatShader.setIVec3("gridSize", used);
+    splatShader.setFloat("coverage", coverage);
+    glDispatchCompute((count + 63) / 64, 1, 1);
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+    // 2) resolve the whole cube, so voxels a bigger grid left behind read as empty
+    glBindImageTexture(0, density, 0, GL_TRUE, 0, GL_READ_ONLY, GL_R32UI);
+    glBindImageTexture(1, extinction, 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_R16F);
+    resolveShader.use();
+    resolveShader.setIVec3("gridSize", glm::ivec3(resolution));
+    const GLuint groups = (resolution + 3) / 4;
+    glDispatchCompute(groups, groups, groups);
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+    // 3) raymarch over the scene
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    glm::vec3 camPos = glm::vec3(glm::inverse(view)[3]);
+    raymarchShader.use();
+    raymarchShader.setMat4("invViewProj", glm::inverse(projection * view));
+    raymarchShader.setVec3("camPos", camPos);
+    raymarchShader.setVec3("boxMin", boundsMin);
+    raymarchShader.setVec3("boxMax", boundsMin + glm::vec3(used) * voxelSize);
+    raymarchShader.setVec3("volumeScale", glm::vec3(1.0f / (voxelSize * resolution)));
+    raymarchShader.setInt("steps", glm::max(settings.steps, 1));
+    raymarchShader.setVec3("color", color);
+    raymarchShader.setIVec2("viewportOrigin", glm::ivec2(viewport[0], viewport[1]));
+    raymarchShader.setIVec2("viewportSize", glm::ivec2(viewport[2], viewport[3]));
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_3D, extinction);
+    glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    glDisable(GL_DEPTH_TEST);
+    glDepthMask(GL_FALSE);
+    glBindVertexArray(blitVao);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindVertexArray(0);
+    glDepthMask(GL_TRUE);
+    glEnable(GL_DEPTH_TEST);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+}
+
+void VolumeSplatter::release() {
+    density.reset();
+    extinction.reset();
+    blitVao.reset();
+    splatShader.release();
+    resolveShader.release();
+    raymarchShader.release();
+    resolution = 0;
+}
@@ -0,0 +1,208 @@
+#ifndef RENDERER_H
+#define RENDERER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+#include "gl_handles.h"
+#include "shader.h"
+#include "chimney.h"
+#include "House.h"
+#include "particles.h"
+#include "gpu_profiler.h"
+
+// ---------- Tiled smoke splatting ----------
+// Compute-shader alternative to the billboard pass, for when the camera is
+// inside the plume and large overlapping quads make blending the bottleneck.
+// Three passes: bin every particle into the 16x16 pixel tiles its screen
+// rectangle touches, sort each tile's list front to back in shared memory,
+// then composite each pixel front to back until the whole tile is opaque.
+// The premultiplied result goes to an RGBA16F image that one fullscreen
+// triangle blends over the scene. Unlike the raster path the smoke is depth
+// sorted, it is not tested against the scene depth (the plume is never behind
+// the house from the default camera), and a tile keeps TILE_CAPACITY
+// particles at most; any more are dropped and counted.
+class TiledSplatter {
+public:
+    static const int TILE_SIZE = 16;
+    static const int TILE_CAPACITY = 1024; // must match the splat_*.comp shaders
+
+    explicit TiledSplatter(int maxParticles);
+
+    // `particles` holds `count` GPUParticles from offset 0; draws into the
+    // bound framebuffer's viewport
+    void draw(GLuint particles, int count, const glm::mat4& view, const glm::mat4& projection,
+        GLuint smokeTexture, glm::vec3 tint);
+
+    // particles dropped from full tiles in the last draw; waits for the GPU
+    int overflow() const;
+
+    // call while the context is still current
+    void release();
+
+private:
+    Shader binShader, sortShader, compositeShader, blitShader;
+    GlBuffer splatBuffer, countBuffer, listBuffer;
+    GlTexture image;
+    GlVertexArray blitVao;
+    int width = 0, height = 0, tilesX = 0, tilesY = 0;
+
+    void resize(int width, int height);
+};
+
+// ---------- Volume smoke ----------
+// For very large particle counts: particles are splatted into a world-space
+// density grid around their bounds (a compute pass with integer image
+// atomics, then a resolve to a filterable float volume) and the smoke is a
+// single raymarch over that grid. After the splat, cost follows the grid
+// resolution and step count instead of the particle count. Each particle
+// becomes a smooth sphere whose optical depth through the centre gives the
+// billboard's opacity; detail finer than a voxel is lost, like the scene
+// depth (see TiledSplatter).
+struct VolumeSettings {
+    int resolution = 96; // voxels along the longest side of the particle bounds (cubic voxels)
+    int steps = 128;     // samples per ray through the bounds
+};
+
+class VolumeSplatter {
+public:
+    static constexpr float DENSITY_SCALE = 4096.0f; // fixed-point steps per unit of extinction, as in volume_*.comp
+
+    VolumeSplatter();
+
+    // `particles` holds `count` GPUParticles within [boundsMin, boundsMax];
+    // draws into the bound framebuffer's viewport
+    void draw(GLuint particles, int count, glm::vec3 boundsMin, glm::vec3 boundsMax, const VolumeSettings& settings,
+        const glm::mat4& view, const glm::mat4& projection, glm::vec3 color, float coverage);
+
+    // call while the context is still current
+    void release();
+
+private:
+    Shader splatShader, resolveShader, raymarchShader;
+    GlTexture density, extinction;
+    GlVertexArray blitVao;
+    int resolution = 0;
+
+    void resize(int resolution);
+};
+
+enum class SmokePath { Raster, Tiled, Volume };
+
+// ---------- Scene renderer ----------
+// Everything that needs a GL context: ground, chimney, house and the smoke
+// billboards / LOD points. The simulation never sees this class; the app
+// hands it packed particles once per frame. Construct it only after the
+// context is current and GL functions are loaded.
+class SceneRenderer {
+public:
+    SmokePath smokePath = SmokePath::Raster; // how the billboards are drawn; LOD points are always raster
+    VolumeSettings volume;                   // grid and step count of SmokePath::Volume
+
+    explicit SceneRenderer(int maxParticles);
+
+    // false if a texture the smoke can't do without failed to load
+    bool valid() const { return texSmoke != 0; }
+
+    // billboards go first in the VBO, LOD points right after them; set
+    // smokePath first, the volume path needs the billboards' bounds
+    void uploadParticles(const GPUParticle* billboards, int numBillboards, const GPUParticle* points, int numPoints);
+
+    // billboards simulated on the GPU (GpuEmitter::renderBuffer()), copied
+    // buffer to buffer; the volume path takes the caller's bounds
+    void uploadParticles(GLuint billboards, int numBillboards, glm::vec3 billboardsMin = glm::vec3(0.0f),
+        glm::vec3 billboardsMax = glm::vec3(0.0f));
+
+    void draw(const glm::mat4& view, const glm::mat4& projection, glm::vec3 camRight, glm::vec3 camUp,
+        float pixelScale, GpuProfiler& profiler);
+
+    // the smoke pass alone, over whatever the bound framebuffer holds
+    void drawSmoke(const glm::mat4& view, const glm::mat4& projection, glm::vec3 camRight, glm::vec3 camUp,
+        float pixelScale);
+
+    // call while the context is still current
+    void release();
+
+    const TiledSplatter& tiledSplatter() const { return tiled; }
+
+private:
+    Shader particleShader, pointShader, chimneyShader, houseShader, groundShader;
+    Chimney chimney;
+    House house;
+    TiledSplatter tiled;
+    VolumeSplatter volumeSplatter;
+    GlVertexArray groundVAO;
+    GlBuffer groundVBO, groundEBO;
+    GlTexture grassTexture;
+    GlTexture texSmoke, texChimney;
+    glm::vec4 smokeMean = glm::vec4(1.0f, 1.0f, 1.0f, 0.5f); // smoke.png: alpha-weighted colour, mean alpha
+    GlVertexArray vao;
+    GlBuffer vbo;
+    int capacity = 0, billboardCount = 0, pointCount = 0;
+    glm::vec3 boundsMin = glm::vec3(0.0f), boundsMax = glm::vec3(0.0f); // billboards, volume path only
+};
+
+// ---------- Offscreen target ----------
+// Colour + depth framebuffer at the full window size. The scene is drawn
+// into its lower-left render size corner and stretched over the window by a
+// linear blit, so changing the render scale never reallocates anything;
+// only a window resize does.
+class OffscreenTarget {
+public:
+    // (re)allocates when the window size changed
+    void resize(int width, int height);
+
+    // binds the target with a viewport of the render size
+    void bind(int renderWidth, int renderHeight);
+
+    // upscales the rendered region onto the default framebuffer and binds it
+    void blitToScreen();
+
+    // call while the context is still current
+    void release();
+
+    GLuint framebuffer() const { return fbo; }
+
+private:
+    GlFramebuffer fbo;
+    GlRenderbuffer color, depth;
+    int width = 0, height = 0;
+    int renderWidth = 0, renderHeight = 0;
+};
+
+// ---------- Pixel readback ----------
+// Reads frames back through a ring of pixel pack buffers. read() only queues
+// an asynchronous glReadPixels into the next free buffer and fences it; a
+// frame is collected once its fence has signalled, normally a frame or two
+// later, so the CPU never waits on the frame it just submitted. Only when
+// every buffer is still in flight does the caller have to wait.
+class PixelReadback {
+public:
+    explicit PixelReadback(int depth = 3);
+
+    // starts reading (0, 0, width, height) of `fbo` as RGBA8; false if the ring is full
+    bool read(GLuint fbo, int width, int height, uint64_t tag);
+
+    // Copies out the oldest frame in flight if its fence has signalled, or
+    // after waiting for it when `wait` is set. False if there is none (yet).
+    bool collect(std::vector<unsigned char>& rgba, int* width, int* height, uint64_t* tag, bool wait);
+
+    int inFlight() const { return pending; }
+
+    // call while the context is still current
+    void release();
+
+private:
+    struct Slot {
+        GlBuffer pbo;
+        GLsync fence = nullptr;
+        size_t capacity = 0;
+        int width = 0, height = 0;
+        uint64_t tag = 0;
+    };
+    std::vector<Slot> slots;
+    int oldest = 0, pending = 0;
+};
+
+#endif // RENDERER_H
@@ -8,10 +8,11 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include "gl_handles.h"
 
 class Shader {
 public:
-    unsigned int ID;
+    GlProgram ID; // registered under the vertex / compute shader path
 
     Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr) {
         std::string vertexCode, fragmentCode, geometryCode;
@@ -57,7 +58,7 @@ public:
         glCompileShader(fragment);
         checkCompileErrors(fragment, "FRAGMENT");
 
-        unsigned int geometry;
+        unsigned int geometry = 0;
         if (geometryPath) {
             geometry = glCreateShader(GL_GEOMETRY_SHADER);
             glShaderSource(geometry, 1, &gShaderCode, nullptr);
@@ -65,7 +66,7 @@ public:
             checkCompileErrors(geometry, "GEOMETRY");
         }
 
-        ID = glCreateProgram();
+        ID.create(vertexPath);
         glAttachShader(ID, vertex);
         glAttachShader(ID, fragment);
         if (geometryPath) glAttachShader(ID, geometry);
@@ -77,27 +78,73 @@ public:
         if (geometryPath) glDeleteShader(geometry);
     }
 
+    // compute program
+    explicit Shader(const char* computePath) {
+        std::string computeCode;
+        std::ifstream cShaderFile;
+        cShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+        try {
+            std::stringstream cShaderStream;
+            cShaderFile.open(computePath);
+            cShaderStream << cShaderFile.rdbuf();
+            cShaderFile.close();
+            computeCode = cShaderStream.str();
+        }
+        catch (std::ifstream::failure& e) {
+            std::cerr << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ\n";
+        }
+
+        ID = buildCompute(computeCode.c_str(), computePath);
+    }
+
+    // compute program from source in memory, e.g. generated
+    static GlProgram buildCompute(const char* source, const char* site) {
+        unsigned int compute = glCreateShader(GL_COMPUTE_SHADER);
+        glShaderSource(compute, 1, &source, nullptr);
+        glCompileShader(compute);
+        checkCompileErrors(compute, "COMPUTE");
+
+        GlProgram program;
+        program.create(site);
+        glAttachShader(program, compute);
+        glLinkProgram(program);
+        checkCompileErrors(program, "PROGRAM");
+        glDeleteShader(compute);
+        return program;
+    }
+
     void use() const { glUseProgram(ID); }
 
-    // uniform helpers
-    void setInt(const std::string& name, int value) const {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+    // call while the context is still current
+    void release() { ID.reset(); }
+
+    // uniform helpers; they take the name as a C string, so no per-call std::string
+    void setInt(const char* name, int value) const {
+        glUniform1i(glGetUniformLocation(ID, name), value);
+    }
+
+    void setFloat(const char* name, float value) const {
+        glUniform1f(glGetUniformLocation(ID, name), value);
+    }
+
+    void setIVec2(const char* name, const glm::ivec2& value) const {
+        glUniform2i(glGetUniformLocation(ID, name), value.x, value.y);
     }
 
-    void setFloat(const std::string& name, float value) const {
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+    void setIVec3(const char* name, const glm::ivec3& value) const {
+        glUniform3i(glGetUniformLocation(ID, name), value.x, value.y, value.z);
     }
 
-    void setVec3(const std::string& name, const glm::vec3& value) const {
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, glm::value_ptr(value));
+    void setVec3(const char* name, const glm::vec3& value) const {
+        glUniform3fv(glGetUniformLocation(ID, name), 1, glm::value_ptr(value));
     }
 
-    void setMat4(const std::string& name, const glm::mat4& mat) const {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, glm::value_ptr(mat));
+    void setMat4(const char* name, const glm::mat4& mat) const {
+        glUniformMatrix4fv(glGetUniformLocation(ID, name), 1, GL_FALSE, glm::value_ptr(mat));
     }
 
 private:
-    void checkCompileErrors(unsigned int shader, std::string type) const {
+    static void checkCompileErrors(unsigned int shader, std::string type) {
         int success;
         char infoLog[1024];
         if (type != "PROGRAM") {
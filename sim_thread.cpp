@@ -0,0 +1,74 @@
+#include "sim_thread.h"
+#include <chrono>
+#include "alloc_tracker.h"
+#include "profiler.h"
+
+static SimSnapshot emptySnapshot(size_t capacity) {
+    SimSnapshot s;
+    s.particles.resize(capacity);
+    return s;
+}
+
+SimThread::SimThread(ParticleSystem& system)
+    : system(system), snapshots(emptySnapshot(system.particles.size())) {}
+
+void SimThread::start(float startTime, const SimControl& initial) {
+    if (running()) return;
+    simTime = startTime;
+    setControl(initial);
+    quit.store(false, std::memory_order_relaxed);
+    worker = std::thread(&SimThread::run, this);
+}
+
+void SimThread::stop() {
+    if (!running()) return;
+    quit.store(true, std::memory_order_relaxed);
+    worker.join();
+}
+
+void SimThread::setControl(const SimControl& c) {
+    control.writeBuffer() = c;
+    control.publish();
+}
+
+void SimThread::run() {
+    using Clock = std::chrono::steady_clock;
+    CpuProfiler::setThreadName("simulation");
+    AllocTracker::setThreadName("simulation");
+    const auto period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / stepHz));
+    Clock::time_point last = Clock::now();
+    Clock::time_point next = last;
+
+    while (!quit.load(std::memory_order_relaxed)) {
+        Clock::time_point now = Clock::now();
+        float dt = std::chrono::duration<float>(now - last).count();
+        last = now;
+        simTime += dt;
+
+        const SimControl& c = control.read();
+        system.simLod = c.simLod;
+        system.setBudget(c.budget);
+        system.setLayout(c.layout);
+        int64_t t0 = CpuProfiler::nowNs();
+        {
+            PROFILE_ZONE("simulate");
+            system.update(dt, simTime, c.spawning);
+        }
+
+        SimSnapshot& s = snapshots.writeBuffer();
+        {
+            PROFILE_ZONE("pack");
+            s.count = system.pack(s.particles.data());
+        }
+        s.stepMs = (CpuProfiler::nowNs() - t0) * 1e-6f;
+        s.simTime = simTime;
+        s.step = ++steps;
+        s.simLodStats = system.simLodStats;
+        snapshots.publish();
+
+        // fixed rate; after a stall, restart the schedule instead of bursting to catch up
+        next += period;
+        if (next < Clock::now()) next = Clock::now();
+        std::this_thread::sleep_until(next);
+    }
+}
@@ -0,0 +1,67 @@
+#ifndef SIM_THREAD_H
+#define SIM_THREAD_H
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+#include "particles.h"
+#include "triple_buffer.h"
+
+// what the render thread tells the simulation each frame
+struct SimControl {
+    bool spawning = true;
+    float budget = 1.0f; // ParticleSystem::setBudget
+    SimLodSettings simLod;
+    PoolLayout layout = PoolLayout::Compact; // ParticleSystem::setLayout
+};
+
+// one completed simulation step, already packed for upload
+struct SimSnapshot {
+    std::vector<GPUParticle> particles;
+    int count = 0;
+    float simTime = 0.0f;
+    uint64_t step = 0;
+    float stepMs = 0.0f; // wall time of the update + pack that produced it
+    SimLodStats simLodStats;
+};
+
+// ---------- Simulation thread ----------
+// Steps a ParticleSystem on its own thread at stepHz and publishes every step
+// as a packed snapshot. The render thread picks up the newest one with
+// latest() and never blocks, so a frame costs max(sim, render) instead of
+// their sum. While running, the thread owns the system: don't touch it until
+// stop() has returned.
+class SimThread {
+public:
+    float stepHz = 60.0f;
+
+    explicit SimThread(ParticleSystem& system);
+    ~SimThread() { stop(); }
+
+    // `initial` is in place before the first step, so it never runs on defaults
+    void start(float startTime, const SimControl& initial);
+    void stop();
+    bool running() const { return worker.joinable(); }
+
+    // render thread only
+    void setControl(const SimControl& c);
+    const SimSnapshot& latest(bool* fresh = nullptr) { return snapshots.read(fresh); }
+
+    // snapshots overwritten before the renderer saw them / frames that reused the previous one
+    uint64_t dropped() const { return snapshots.droppedCount(); }
+    uint64_t duplicated() const { return snapshots.duplicatedCount(); }
+
+private:
+    ParticleSystem& system;
+    TripleBuffer<SimSnapshot> snapshots;
+    TripleBuffer<SimControl> control;
+    std::thread worker;
+    std::atomic<bool> quit{ false };
+    float simTime = 0.0f;
+    uint64_t steps = 0;
+
+    void run();
+};
+
+#endif // SIM_THREAD_H
@@ -0,0 +1,313 @@
+// Microbenchmarks for the smoke simulation kernels.
+//
+//   smoke_bench [--repeats N] [--cpu N] [--sizes 1000,10000,...] [--json results.json] [--gpu]
+//
+// --cpu pins the benchmark thread (default 0, -1 leaves it unpinned).
+// --gpu (builds with EGL only) adds the smoke pass itself, billboard raster
+// vs. compute-shader tiles vs. the raymarched volume, drawn at 1280x720 from
+// a camera inside the plume and timed to glFinish; run it from the
+// repository root for the shaders.
+// Every kernel runs on fixed-seed inputs at each particle count, is repeated
+// N times after one warm-up run, and is reported as ns/particle (mean, stddev, min).
+// Kernels that change their inputs get them restored before every run, untimed.
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#endif
+#include "noise.h"
+#include "particles.h"
+#if SMOKE_BENCH_GPU
+#include <glad/glad.h>
+#include <glm/gtc/matrix_transform.hpp>
+#include "egl_context.h"
+#include "gl_registry.h"
+#include "renderer.h"
+#endif
+
+// ---------- Harness ----------
+struct Kernel {
+    const char* name;
+    std::function<void(int n)> setup; // untimed, once per size
+    std::function<void(int n)> run;   // timed
+    std::function<void()> reset = nullptr; // untimed, before every run; optional
+};
+
+struct Result {
+    std::string kernel;
+    int particles;
+    double meanNs, stddevNs, minNs; // per particle
+    int repeats;
+};
+
+static volatile float sink; // keeps results observable so the optimizer can't drop the work
+
+static bool pinToCpu(int cpu) {
+#ifdef _WIN32
+    return SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << cpu) != 0;
+#else
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#endif
+}
+
+static Result measure(const Kernel& k, int n, int repeats) {
+    k.setup(n);
+    if (k.reset) k.reset();
+    k.run(n); // warm-up
+    std::vector<double> ns(repeats);
+    for (int r = 0; r < repeats; ++r) {
+        if (k.reset) k.reset();
+        auto t0 = std::chrono::steady_clock::now();
+        k.run(n);
+        auto t1 = std::chrono::steady_clock::now();
+        ns[r] = std::chrono::duration<double, std::nano>(t1 - t0).count() / n;
+    }
+    double mean = 0.0;
+    for (double v : ns) mean += v;
+    mean /= repeats;
+    double var = 0.0;
+    for (double v : ns) var += (v - mean) * (v - mean);
+    double stddev = repeats > 1 ? std::sqrt(var / (repeats - 1)) : 0.0;
+    return { k.name, n, mean, stddev, *std::min_element(ns.begin(), ns.end()), repeats };
+}
+
+static std::string compilerName() {
+#if defined(__clang__)
+    return "clang " __clang_version__;
+#elif defined(__GNUC__)
+    return "gcc " __VERSION__;
+#elif defined(_MSC_VER)
+    return "msvc " + std::to_string(_MSC_VER);
+#else
+    return "unknown";
+#endif
+}
+
+static bool writeJson(const char* path, const std::vector<Result>& results, int repeats, int cpu) {
+    std::ofstream f(path);
+    if (!f) { std::cerr << "Failed to write " << path << "\n"; return false; }
+    f << "{\n  \"compiler\": \"" << compilerName() << "\""
+      << ",\n  \"repeats\": " << repeats << ",\n  \"cpu\": " << cpu << ",\n  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result& r = results[i];
+        f << "    { \"kernel\": \"" << r.kernel << "\", \"particles\": " << r.particles
+          << ", \"ns_per_particle\": " << r.meanNs << ", \"stddev\": " << r.stddevNs
+          << ", \"min\": " << r.minNs << " }" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    f << "  ]\n}\n";
+    return true;
+}
+
+// ---------- Kernels ----------
+// Inputs are rebuilt from fixed seeds in every kernel's setup, so no kernel
+// sees what another one left behind.
+struct BenchState {
+    std::vector<glm::vec3> points;
+    std::vector<Particle> scratch;
+    std::vector<GPUParticle> gpu;
+    std::unique_ptr<ParticleSystem> system;
+    std::vector<Particle> keptParticles; // what restoreSystem() puts back
+    std::vector<Emitter> keptEmitters;
+
+    void makePoints(int n) {
+        Rng rng(42);
+        points.resize(n);
+        for (glm::vec3& p : points)
+            p = glm::vec3(rng.uniform() * 8.0f - 4.0f, rng.uniform() * 12.0f, rng.uniform() * 8.0f - 4.0f);
+    }
+
+    // a full pool of the default chimney with particles spread over their whole lifetime
+    void makeSystem(int n) {
+        system = std::make_unique<ParticleSystem>(n, 1, 42);
+        Emitter e;
+        e.burst = n;
+        e.spawnInterval = 0.0f;
+        system->addEmitter(e, n);
+        system->update(1.0f / 60.0f, 0.0f, true);
+        Rng rng(7);
+        for (Particle& p : system->particles) {
+            p.life = rng.uniform();
+            p.pos.y += p.life * e.lifeSpan * 0.5f;
+            p.pos.x += (rng.uniform() - 0.5f) * p.life * 4.0f;
+            p.pos.z += (rng.uniform() - 0.5f) * p.life * 4.0f;
+        }
+        gpu.resize(n);
+    }
+
+    // updates age and retire particles and the sort permutes them; runs start from the kept state
+    void keepSystem() {
+        keptParticles = system->particles;
+        keptEmitters = system->emitters;
+    }
+    void restoreSystem() {
+        std::copy(keptParticles.begin(), keptParticles.end(), system->particles.begin());
+        std::copy(keptEmitters.begin(), keptEmitters.end(), system->emitters.begin());
+    }
+};
+
+int main(int argc, char** argv) {
+    int repeats = 10;
+    int cpu = 0;
+    const char* jsonPath = nullptr;
+    bool gpu = false;
+    std::vector<int> sizes = { 1000, 10000, 100000, 1000000 };
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--repeats" && hasValue) repeats = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--cpu" && hasValue) cpu = std::atoi(argv[++i]);
+        else if (arg == "--json" && hasValue) jsonPath = argv[++i];
+        else if (arg == "--gpu") gpu = true;
+        else if (arg == "--sizes" && hasValue) {
+            sizes.clear();
+            for (char* tok = std::strtok(argv[++i], ","); tok; tok = std::strtok(nullptr, ","))
+                sizes.push_back(std::atoi(tok));
+        }
+        else {
+            std::cerr << "Usage: " << argv[0] << " [--repeats N] [--cpu N] [--sizes a,b,...] [--json out.json] [--gpu]\n";
+            return 1;
+        }
+    }
+    if (cpu >= 0 && !pinToCpu(cpu)) std::cerr << "Warning: could not pin to CPU " << cpu << "\n";
+
+    initNoise();
+    BenchState st;
+    const float dt = 1.0f / 60.0f;
+
+    std::vector<Kernel> kernels = {
+        { "perlin",
+          [&](int n) { st.makePoints(n); },
+          [&](int n) {
+              float acc = 0.0f;
+              for (int i = 0; i < n; ++i) acc += perlin(st.points[i].x, st.points[i].y, st.points[i].z);
+              sink = acc;
+          } },
+        { "noiseVelocity",
+          [&](int n) { st.makePoints(n); },
+          [&](int n) {
+              glm::vec3 acc(0.0f);
+              for (int i = 0; i < n; ++i) acc += noiseVelocity(st.points[i], 3.0f);
+              sink = acc.x + acc.z;
+          } },
+        { "respawnParticle",
+          [&](int n) { st.scratch.resize(n); },
+          [&](int n) {
+              Rng rng(42);
+              Emitter e;
+              for (int i = 0; i < n; ++i) respawnParticle(st.scratch[i], e, 0, rng);
+              sink = st.scratch[n - 1].pos.x;
+          } },
+        { "update",
+          [&](int n) { st.makeSystem(n); st.keepSystem(); },
+          [&](int) {
+              st.system->update(dt, 3.0f, false);
+              sink = st.system->particles[0].pos.y;
+          },
+          [&] { st.restoreSystem(); } },
+        { "pack",
+          [&](int n) { st.makeSystem(n); },
+          [&](int) {
+              int count = st.system->pack(st.gpu.data());
+              sink = st.gpu[count - 1].py;
+          } },
+        // the same update once the pool is in Morton order, and the sort of the scattered pool
+        { "update morton",
+          [&](int n) { st.makeSystem(n); st.system->reorder(); st.keepSystem(); },
+          [&](int) {
+              st.system->update(dt, 3.0f, false);
+              sink = st.system->particles[0].pos.y;
+          },
+          [&] { st.restoreSystem(); } },
+        { "reorder",
+          [&](int n) { st.makeSystem(n); st.keepSystem(); },
+          [&](int) {
+              st.system->reorder();
+              sink = st.system->particles[0].pos.y;
+          },
+          [&] { st.restoreSystem(); } },
+    };
+
+#if SMOKE_BENCH_GPU
+    // both smoke paths over the same packed particles; the smoke texture and
+    // shaders are the viewer's, the frame is cleared to the sky colour
+    EglContext egl;
+    std::unique_ptr<SceneRenderer> renderer;
+    OffscreenTarget target;
+    const int gpuWidth = 1280, gpuHeight = 720;
+    const glm::vec3 eye(0.7f, 4.0f, 2.5f), lookAt(0.7f, 4.0f, -1.0f), worldUp(0.0f, 1.0f, 0.0f);
+    const glm::mat4 view = glm::lookAt(eye, lookAt, worldUp);
+    const glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)gpuWidth / gpuHeight, 0.1f, 100.0f);
+    if (gpu) {
+        if (!egl.create() || !gladLoadGLLoader((GLADloadproc)eglGetProcAddress)) return 1;
+        renderer = std::make_unique<SceneRenderer>(*std::max_element(sizes.begin(), sizes.end()));
+        if (!renderer->valid()) return 1;
+        target.resize(gpuWidth, gpuHeight);
+        std::cout << "renderer: " << glGetString(GL_RENDERER) << "\n";
+    }
+    auto smokeKernel = [&](const char* name, SmokePath path) {
+        return Kernel{ name,
+            [&, path](int n) {
+                st.makeSystem(n);
+                int count = st.system->pack(st.gpu.data());
+                renderer->smokePath = path;
+                renderer->uploadParticles(st.gpu.data(), count, nullptr, 0);
+            },
+            [&](int) {
+                target.bind(gpuWidth, gpuHeight);
+                glClearColor(0.55f, 0.75f, 0.95f, 1.0f);
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                renderer->drawSmoke(view, projection, glm::vec3(1.0f, 0.0f, 0.0f), worldUp, projection[1][1] * gpuHeight * 0.5f);
+                glFinish();
+            } };
+    };
+    if (gpu) {
+        kernels.push_back(smokeKernel("smoke raster", SmokePath::Raster));
+        kernels.push_back(smokeKernel("smoke tiled", SmokePath::Tiled));
+        kernels.push_back(smokeKernel("smoke volume", SmokePath::Volume));
+    }
+#else
+    if (gpu) std::cerr << "Warning: built without EGL, --gpu ignored\n";
+#endif
+
+    std::vector<Result> results;
+    std::printf("%-16s %10s %14s %12s %12s\n", "kernel", "particles", "ns/particle", "stddev", "min");
+    for (const Kernel& k : kernels) {
+        for (int n : sizes) {
+            Result r = measure(k, n, repeats);
+            std::printf("%-16s %10d %14.2f %12.2f %12.2f\n", r.kernel.c_str(), r.particles, r.meanNs, r.stddevNs, r.minNs);
+            std::fflush(stdout);
+            results.push_back(r);
+#if SMOKE_BENCH_GPU
+            if (gpu && std::strcmp(k.name, "smoke tiled") == 0 && renderer->tiledSplatter().overflow() > 0)
+                std::printf("%-16s %10s (%d tile entries dropped, tiles full)\n", "", "", renderer->tiledSplatter().overflow());
+#endif
+        }
+    }
+    if (jsonPath && writeJson(jsonPath, results, repeats, cpu))
+        std::cout << "Results written to " << jsonPath << "\n";
+#if SMOKE_BENCH_GPU
+    if (renderer) {
+        target.release();
+        renderer->release();
+        GlRegistry::reportLeaks(std::cerr);
+    }
+#endif
+    return 0;
+}
@@ -0,0 +1,196 @@
+// Runs the smoke simulation without a window or GL context.
+//
+//   smoke_headless [--frames N] [--dt S] [--seed N] [--particles N] [--emitters N] [--sim-lod] [--threads N] [--ring]
+//                  [--motion plume|calm|jet] [--reorder N] [--prewarm S] [--load-state PATH] [--save-state PATH] [--record PATH]
+//                  [--image PATH [--width W] [--height H]] [--alloc-check N]
+//
+// Emitters are spread along x around the default chimney and share the pool
+// evenly. Prints timing, the live particle count and a checksum of the final
+// packed particles, so two runs with the same arguments can be compared;
+// the thread count does not change the result. --load-state starts from a
+// state file (e.g. one attached to a bug report) instead of an empty sky;
+// --motion picks the emitters' update kernel (EmitterMotion);
+// --reorder sorts the pool into Morton order every N frames, which permutes
+// the packed order and so the checksum;
+// --record writes every frame as a recording the viewer can --play;
+// --image draws the final frame from the viewer's camera with the CPU
+// splatting renderer (smoke only, over the sky colour) and writes a PNG;
+// --alloc-check fails the run if any frame after the first N allocates
+// (needs a SMOKE_ALLOC_TRACKING build) and prints who allocated how much.
+#include <glm/glm.hpp>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <glm/gtc/matrix_transform.hpp>
+#include "alloc_tracker.h"
+#include "image_writer.h"
+#include "noise.h"
+#include "particle_stream.h"
+#include "particles.h"
+#include "splat_renderer.h"
+#include "thread_pool.h"
+
+// FNV-1a over the raw bytes
+static uint64_t checksum(const void* data, size_t bytes) {
+    const unsigned char* p = (const unsigned char*)data;
+    uint64_t h = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < bytes; ++i) {
+        h ^= p[i];
+        h *= 0x100000001b3ull;
+    }
+    return h;
+}
+
+int main(int argc, char** argv) {
+    int frames = 600;
+    float dt = 1.0f / 60.0f;
+    uint64_t seed = 1;
+    int maxParticles = 1000;
+    int emitterCount = 1;
+    bool simLod = false;
+    int threads = 0;
+    bool ring = false;
+    int reorder = 0;
+    EmitterMotion motion = EmitterMotion::Plume;
+    float prewarm = 0.0f;
+    std::string loadPath, savePath, recordPath, imagePath;
+    int width = 640, height = 360;
+    int allocWarmup = -1;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--frames" && hasValue) frames = std::atoi(argv[++i]);
+        else if (arg == "--dt" && hasValue) dt = (float)std::atof(argv[++i]);
+        else if (arg == "--seed" && hasValue) seed = std::strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--particles" && hasValue) maxParticles = std::atoi(argv[++i]);
+        else if (arg == "--emitters" && hasValue) emitterCount = std::atoi(argv[++i]);
+        else if (arg == "--sim-lod") simLod = true;
+        else if (arg == "--threads" && hasValue) threads = std::atoi(argv[++i]);
+        else if (arg == "--ring") ring = true;
+        else if (arg == "--reorder" && hasValue) reorder = std::atoi(argv[++i]);
+        else if (arg == "--motion" && hasValue) {
+            std::string m = argv[++i];
+            if (m == "plume") motion = EmitterMotion::Plume;
+            else if (m == "calm") motion = EmitterMotion::Calm;
+            else if (m == "jet") motion = EmitterMotion::Jet;
+            else { std::cerr << "--motion expects plume, calm or jet\n"; return 1; }
+        }
+        else if (arg == "--prewarm" && hasValue) prewarm = (float)std::atof(argv[++i]);
+        else if (arg == "--load-state" && hasValue) loadPath = argv[++i];
+        else if (arg == "--save-state" && hasValue) savePath = argv[++i];
+        else if (arg == "--record" && hasValue) recordPath = argv[++i];
+        else if (arg == "--image" && hasValue) imagePath = argv[++i];
+        else if (arg == "--width" && hasValue) width = std::atoi(argv[++i]);
+        else if (arg == "--height" && hasValue) height = std::atoi(argv[++i]);
+        else if (arg == "--alloc-check" && hasValue) allocWarmup = std::atoi(argv[++i]);
+        else {
+            std::cerr << "Usage: " << argv[0]
+                << " [--frames N] [--dt S] [--seed N] [--particles N] [--emitters N] [--sim-lod] [--threads N] [--ring]\n"
+                << "       [--motion plume|calm|jet] [--reorder N] [--prewarm S] [--load-state PATH] [--save-state PATH] [--record PATH]\n"
+                << "       [--image PATH [--width W] [--height H]] [--alloc-check N]\n";
+            return 1;
+        }
+    }
+    if (frames < 0 || dt <= 0.0f || emitterCount < 1 || maxParticles < emitterCount || width < 1 || height < 1 || reorder < 0) {
+        std::cerr << "Invalid arguments\n";
+        return 1;
+    }
+    if (allocWarmup >= 0 && !AllocTracker::enabled()) {
+        std::cerr << "--alloc-check needs a build with SMOKE_ALLOC_TRACKING=ON\n";
+        return 1;
+    }
+
+    initNoise();
+    ParticleSystem smoke(maxParticles, emitterCount, seed);
+    ThreadPool pool(threads);
+    smoke.setThreadPool(&pool);
+    if (ring) smoke.setLayout(PoolLayout::Ring);
+    smoke.reorderInterval = reorder;
+    for (int i = 0; i < emitterCount; ++i) {
+        Emitter e;
+        e.pos.x += (i - (emitterCount - 1) * 0.5f) * 1.5f;
+        e.motion = motion;
+        smoke.addEmitter(e, maxParticles / emitterCount);
+    }
+    // the viewer's default camera, so sim LOD tiers match what it would pick
+    smoke.simLod.enabled = simLod;
+    smoke.simLod.camPos = glm::vec3(0.0f, 2.0f, 6.0f);
+
+    // a state file replaces the emitters above and carries its own clock
+    float startTime = 0.0f;
+    if (!loadPath.empty() && !smoke.loadState(loadPath, &startTime)) return 1;
+
+    // the viewer's --prewarm: coarse 0.1 s steps, ending where frame 0 starts
+    if (prewarm > 0.0f) {
+        PrewarmStats warm = smoke.prewarm(prewarm, 0.1f, startTime);
+        std::printf("prewarm: %.1f s in %d steps, %.3f ms on %d thread%s, %d particles\n", warm.simulated, warm.steps, warm.ms,
+            warm.threads, warm.threads == 1 ? "" : "s", smoke.liveCount());
+    }
+
+    ParticleRecorder recorder;
+    if (!recordPath.empty() && !recorder.open(recordPath)) return 1;
+    std::vector<GPUParticle> packed(maxParticles);
+    double recordMs = 0.0;
+    AllocTracker::setThreadName("main");
+    if (allocWarmup >= 0) AllocTracker::steadyAfter(allocWarmup);
+
+    auto t0 = std::chrono::steady_clock::now();
+    for (int f = 0; f < frames; ++f) {
+        AllocTracker::beginFrame(f);
+        smoke.update(dt, startTime + f * dt, true);
+        if (recorder.isOpen()) {
+            auto r0 = std::chrono::steady_clock::now();
+            recorder.addFrame(packed.data(), smoke.pack(packed.data()), startTime + (f + 1) * dt);
+            recordMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - r0).count();
+        }
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    double ms = std::chrono::duration<double, std::milli>(t1 - t0).count() - recordMs;
+
+    int live = smoke.pack(packed.data());
+    std::printf("frames: %d, emitters: %d, threads: %d, live particles: %d\n", frames, emitterCount, pool.size(), live);
+    std::printf("simulation: %.3f ms total, %.4f ms/frame\n", ms, frames ? ms / frames : 0.0);
+    std::printf("checksum: %016llx\n", (unsigned long long)checksum(packed.data(), sizeof(GPUParticle) * live));
+    if (recorder.isOpen()) {
+        if (!recorder.close()) return 1;
+        std::printf("recording: %d frames, %.1f MB -> %.1f MB, %.3f ms/frame\n", recorder.frames(),
+            recorder.rawBytes() / 1048576.0, recorder.fileBytes() / 1048576.0, frames ? recordMs / frames : 0.0);
+    }
+    if (allocWarmup >= 0) {
+        AllocTracker::beginFrame(frames); // closes the last frame's counts
+        AllocTracker::printReport();
+        if (AllocTracker::steadyAllocations()) {
+            std::cerr << AllocTracker::steadyAllocations() << " allocations after frame " << allocWarmup << "\n";
+            return 1;
+        }
+    }
+    if (!savePath.empty() && !smoke.saveState(savePath, startTime + frames * dt)) return 1;
+
+    if (!imagePath.empty()) {
+        SplatRenderer splatter;
+        splatter.setThreadPool(&pool);
+        if (!splatter.loadTexture("smoke.png")) return 1;
+        SplatCamera cam;
+        glm::vec3 eye(0.0f, 2.0f, 6.0f), target(0.0f, 1.0f, 0.0f);
+        cam.view = glm::lookAt(eye, target, glm::vec3(0.0f, 1.0f, 0.0f));
+        cam.projection = glm::perspective(glm::radians(45.0f), (float)width / height, 0.1f, 100.0f);
+        cam.width = width;
+        cam.height = height;
+        SplatImage image;
+        auto s0 = std::chrono::steady_clock::now();
+        splatter.render(packed.data(), live, cam, image);
+        double splatMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - s0).count();
+        std::vector<unsigned char> rgba;
+        image.toRgba8(rgba);
+        if (!writePng(imagePath, width, height, rgba.data())) return 1;
+        const SplatStats& st = splatter.stats();
+        std::printf("image: %dx%d, %d splats over %d tiles (%d bins), %.3f ms\n", width, height, st.splats, st.tiles,
+            st.binned, splatMs);
+    }
+    return 0;
+}
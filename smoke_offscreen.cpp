@@ -0,0 +1,220 @@
+// Renders the scene without a window or display, e.g. for thumbnails and
+// visual regression tests on a server.
+//
+//   smoke_offscreen [--frames N] [--width W] [--height H] [--out frame_%04d.png] [--format png|raw]
+//                   [--camera X,Y,Z] [--target X,Y,Z] [--fov DEG] [--dt S] [--seed N]
+//                   [--particles N] [--prewarm S] [--skip N] [--smoke raster|tiled|volume]
+//                   [--volume-res N] [--volume-steps N] [--gpu-sim]
+//
+// The GL 4.5 core context comes from EGL without a surface (Mesa's
+// surfaceless platform, so llvmpipe works with no GPU at all) and the scene
+// is drawn into an offscreen framebuffer. Frames come back through a ring of
+// pixel pack buffers and are encoded on a background thread. Run it from the
+// repository root so the shaders and textures are found. The simulation is
+// seeded, so the same arguments give the same images. --smoke tiled draws the
+// smoke with the compute-shader splatter instead of the billboard pass,
+// --smoke volume raymarches a density grid of --volume-res voxels.
+// --gpu-sim simulates the chimney with a generated compute kernel
+// (GpuEmitter) instead of the CPU particle system; --particles is ignored.
+// At the end it prints the GL objects and memory the run held, and fails if
+// any object is still alive once everything has been released.
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "egl_context.h"
+#include "gl_registry.h"
+#include "gpu_emitter.h"
+#include "image_writer.h"
+#include "noise.h"
+#include "particles.h"
+#include "renderer.h"
+#include "thread_pool.h"
+
+struct Options {
+    int frames = 60;
+    int width = 640, height = 360;
+    std::string out = "frame_%04d.png";
+    ImageFormat format = ImageFormat::Png;
+    glm::vec3 camera = glm::vec3(0.0f, 2.0f, 6.0f); // the viewer's camera
+    glm::vec3 target = glm::vec3(0.0f, 1.0f, 0.0f);
+    float fov = 45.0f;
+    float dt = 1.0f / 60.0f;
+    uint64_t seed = 1;
+    int particles = 1000;
+    float prewarm = 0.0f;
+    int skip = 0; // frames simulated and rendered before the first one written
+    SmokePath smoke = SmokePath::Raster;
+    VolumeSettings volume;
+    bool gpuSim = false;
+};
+
+static bool parseVec3(const char* s, glm::vec3& v) {
+    return std::sscanf(s, "%f,%f,%f", &v.x, &v.y, &v.z) == 3;
+}
+
+static bool parseOptions(int argc, char** argv, Options& o) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        bool ok = true;
+        if (arg == "--frames" && hasValue) o.frames = std::atoi(argv[++i]);
+        else if (arg == "--width" && hasValue) o.width = std::atoi(argv[++i]);
+        else if (arg == "--height" && hasValue) o.height = std::atoi(argv[++i]);
+        else if (arg == "--out" && hasValue) o.out = argv[++i];
+        else if (arg == "--format" && hasValue) {
+            std::string f = argv[++i];
+            ok = f == "png" || f == "raw";
+            o.format = f == "raw" ? ImageFormat::Raw : ImageFormat::Png;
+        }
+        else if (arg == "--camera" && hasValue) ok = parseVec3(argv[++i], o.camera);
+        else if (arg == "--target" && hasValue) ok = parseVec3(argv[++i], o.target);
+        else if (arg == "--fov" && hasValue) o.fov = (float)std::atof(argv[++i]);
+        else if (arg == "--dt" && hasValue) o.dt = (float)std::atof(argv[++i]);
+        else if (arg == "--seed" && hasValue) o.seed = std::strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--particles" && hasValue) o.particles = std::atoi(argv[++i]);
+        else if (arg == "--prewarm" && hasValue) o.prewarm = (float)std::atof(argv[++i]);
+        else if (arg == "--skip" && hasValue) o.skip = std::atoi(argv[++i]);
+        else if (arg == "--smoke" && hasValue) {
+            std::string m = argv[++i];
+            ok = m == "raster" || m == "tiled" || m == "volume";
+            o.smoke = m == "tiled" ? SmokePath::Tiled : m == "volume" ? SmokePath::Volume : SmokePath::Raster;
+        }
+        else if (arg == "--volume-res" && hasValue) o.volume.resolution = std::atoi(argv[++i]);
+        else if (arg == "--volume-steps" && hasValue) o.volume.steps = std::atoi(argv[++i]);
+        else if (arg == "--gpu-sim") o.gpuSim = true;
+        else ok = false;
+        if (!ok) {
+            std::cerr << "Usage: " << argv[0]
+                << " [--frames N] [--width W] [--height H] [--out frame_%04d.png] [--format png|raw]\n"
+                << "       [--camera X,Y,Z] [--target X,Y,Z] [--fov DEG] [--dt S] [--seed N]\n"
+                << "       [--particles N] [--prewarm S] [--skip N] [--smoke raster|tiled|volume]\n"
+                << "       [--volume-res N] [--volume-steps N] [--gpu-sim]\n";
+            return false;
+        }
+    }
+    if (o.frames < 0 || o.width < 1 || o.height < 1 || o.dt <= 0.0f || o.particles < 1 || o.skip < 0
+        || o.fov <= 0.0f || o.fov >= 180.0f || o.volume.resolution < 2 || o.volume.steps < 1) {
+        std::cerr << "Invalid arguments\n";
+        return false;
+    }
+    return true;
+}
+
+static std::string framePath(const std::string& pattern, int index) {
+    char buf[1024];
+    std::snprintf(buf, sizeof(buf), pattern.c_str(), index);
+    return buf;
+}
+
+int main(int argc, char** argv) {
+    Options opts;
+    if (!parseOptions(argc, argv, opts)) return 1;
+
+    EglContext egl;
+    if (!egl.create()) return 1;
+    if (!gladLoadGLLoader((GLADloadproc)eglGetProcAddress)) { std::cerr << "Failed to init GLAD\n"; return 1; }
+    std::cout << "renderer: " << glGetString(GL_RENDERER) << "\n";
+
+    initNoise();
+    ParticleSystem smoke(opts.particles, 16, opts.seed);
+    smoke.addEmitter(Emitter(), opts.particles);
+    ThreadPool pool;
+    smoke.setThreadPool(&pool);
+    if (opts.prewarm > 0.0f && !opts.gpuSim) smoke.prewarm(opts.prewarm, 0.1f, 0.0f);
+    std::vector<GPUParticle> gpuData(opts.particles);
+
+    int exitCode = 0;
+    {
+        GpuProgramCache programs;
+        std::unique_ptr<GpuEmitter> gpuEmitter;
+        if (opts.gpuSim) {
+            GpuEmitterType chimney;
+            chimney.trackBounds = opts.smoke == SmokePath::Volume;
+            gpuEmitter = std::make_unique<GpuEmitter>(chimney, programs, (uint32_t)opts.seed);
+            // the same coarse fast-forward as ParticleSystem::prewarm
+            for (float t = 0.1f; t <= opts.prewarm; t += 0.1f) gpuEmitter->update(0.1f, t);
+        }
+        SceneRenderer renderer(gpuEmitter ? gpuEmitter->slots() : opts.particles);
+        if (!renderer.valid()) return 1;
+        renderer.smokePath = opts.smoke;
+        renderer.volume = opts.volume;
+        OffscreenTarget target;
+        target.resize(opts.width, opts.height);
+        PixelReadback readback;
+        ImageWriter writer;
+        GpuProfiler profiler; // stays disabled
+
+        glm::vec3 worldUp(0.0f, 1.0f, 0.0f);
+        glm::mat4 view = glm::lookAt(opts.camera, opts.target, worldUp);
+        glm::vec3 forward = glm::normalize(opts.target - opts.camera);
+        glm::vec3 right = glm::normalize(glm::cross(forward, worldUp));
+        glm::vec3 up = glm::cross(right, forward);
+        glm::mat4 projection = glm::perspective(glm::radians(opts.fov), (float)opts.width / opts.height, 0.1f, 100.0f);
+        float pixelScale = projection[1][1] * opts.height * 0.5f;
+
+        std::vector<unsigned char> pixels;
+        int waits = 0;
+        // hands every finished readback to the writer thread
+        auto drain = [&](bool wait) {
+            int w, h;
+            uint64_t frame;
+            while (readback.collect(pixels, &w, &h, &frame, wait)) {
+                writer.push(framePath(opts.out, (int)frame), w, h, pixels, opts.format);
+                if (wait) return;
+            }
+        };
+
+        auto t0 = std::chrono::steady_clock::now();
+        const int total = opts.skip + opts.frames;
+        for (int f = 0; f < total; ++f) {
+            if (gpuEmitter) {
+                gpuEmitter->update(opts.dt, opts.prewarm + f * opts.dt);
+                glm::vec3 lo(0.0f), hi(0.0f);
+                gpuEmitter->bounds(lo, hi);
+                renderer.uploadParticles(gpuEmitter->renderBuffer(), gpuEmitter->slots(), lo, hi);
+            }
+            else {
+                smoke.update(opts.dt, opts.prewarm + f * opts.dt, true);
+                int count = smoke.pack(gpuData.data());
+                renderer.uploadParticles(gpuData.data(), count, nullptr, 0);
+            }
+            target.bind(opts.width, opts.height);
+            renderer.draw(view, projection, right, up, pixelScale, profiler);
+            if (f < opts.skip) continue;
+            while (!readback.read(target.framebuffer(), opts.width, opts.height, (uint64_t)(f - opts.skip))) {
+                ++waits; // every buffer still in flight
+                drain(true);
+            }
+            drain(false);
+        }
+        while (readback.inFlight() > 0) drain(true);
+        auto t1 = std::chrono::steady_clock::now();
+        writer.finish();
+        auto t2 = std::chrono::steady_clock::now();
+
+        double renderMs = std::chrono::duration<double, std::milli>(t1 - t0).count();
+        double writeMs = std::chrono::duration<double, std::milli>(t2 - t1).count();
+        std::printf("frames: %d at %dx%d, %.3f ms/frame, readback waits: %d\n", opts.frames, opts.width, opts.height,
+            total ? renderMs / total : 0.0, waits);
+        std::printf("images: %d written, %d failed, %.1f ms after the last frame\n", writer.written(), writer.failed(), writeMs);
+        if (writer.failed() > 0) exitCode = 1;
+
+        if (gpuEmitter) std::printf("gpu sim: %d slots, %d kernel(s) compiled\n", gpuEmitter->slots(), programs.compiled());
+        GlRegistry::printTotals(std::cout);
+
+        if (gpuEmitter) gpuEmitter->release();
+        programs.release();
+        readback.release();
+        target.release();
+        renderer.release();
+        if (GlRegistry::reportLeaks(std::cerr) > 0) exitCode = 1;
+    }
+    return exitCode;
+}
@@ -0,0 +1,883 @@
+// Unit tests for the GL-free smoke_core code. No framework: each test is a
+// function, CHECK records failures and the process exit code is the number
+// of failed tests, which is what ctest looks at.
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <thread>
+#include <tuple>
+#include <vector>
+#include "noise.h"
+#include "particles.h"
+#include "culling.h"
+#include "lod.h"
+#include "triple_buffer.h"
+#include "budget.h"
+#include "dynamic_resolution.h"
+#include "thread_pool.h"
+#include "particle_stream.h"
+#include "image_writer.h"
+#include "splat_renderer.h"
+#include "emitter_codegen.h"
+#include "alloc_tracker.h"
+#include "gl_registry.h"
+#if SMOKE_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+static int checksFailed = 0;
+
+#define CHECK(cond) \
+    do { if (!(cond)) { std::printf("  %s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); ++checksFailed; } } while (0)
+
+// ---------- Tests ----------
+static void testRngDeterminism() {
+    Rng a(123), b(123), c(124);
+    bool same = true, differs = false;
+    for (int i = 0; i < 1000; ++i) {
+        uint64_t x = a.next();
+        same = same && x == b.next();
+        differs = differs || x != c.next();
+    }
+    CHECK(same);
+    CHECK(differs);
+
+    Rng r(7);
+    for (int i = 0; i < 10000; ++i) {
+        float u = r.uniform();
+        CHECK(u >= 0.0f && u < 1.0f);
+    }
+}
+
+static void testPerlinRange() {
+    Rng r(1);
+    float lo = 1.0f, hi = 0.0f;
+    for (int i = 0; i < 10000; ++i) {
+        float v = perlin(r.uniform() * 50.0f, r.uniform() * 50.0f, r.uniform() * 50.0f);
+        lo = std::min(lo, v);
+        hi = std::max(hi, v);
+    }
+    CHECK(lo >= 0.0f && hi <= 1.0f);
+    CHECK(hi - lo > 0.3f); // it actually varies
+    // integer lattice points are always 0.5
+    CHECK(std::fabs(perlin(3.0f, 4.0f, 5.0f) - 0.5f) < 1e-6f);
+}
+
+static void testEmitterSlices() {
+    ParticleSystem ps(100, 4, 1);
+    CHECK(ps.addEmitter(Emitter(), 60) == 0);
+    CHECK(ps.addEmitter(Emitter(), 40) == 1);
+    CHECK(ps.addEmitter(Emitter(), 1) == -1); // pool is full
+    CHECK(ps.emitters[1].first == 60);
+
+    // never spawns past its own capacity
+    for (int f = 0; f < 2000; ++f) ps.update(1.0f / 60.0f, f / 60.0f, true);
+    CHECK(ps.emitters[0].count <= 60);
+    CHECK(ps.emitters[1].count <= 40);
+    CHECK(ps.liveCount() == ps.emitters[0].count + ps.emitters[1].count);
+    for (int i = 0; i < ps.emitters[1].count; ++i)
+        CHECK(ps.particles[60 + i].emitter == 1);
+}
+
+static void testUpdateIsDeterministic() {
+    ParticleSystem a(500, 1, 99), b(500, 1, 99);
+    a.addEmitter(Emitter(), 500);
+    b.addEmitter(Emitter(), 500);
+    for (int f = 0; f < 300; ++f) {
+        a.update(1.0f / 60.0f, f / 60.0f, true);
+        b.update(1.0f / 60.0f, f / 60.0f, true);
+    }
+    CHECK(a.liveCount() == b.liveCount());
+    bool same = true;
+    for (int i = 0; i < a.liveCount(); ++i)
+        same = same && a.particles[i].pos == b.particles[i].pos;
+    CHECK(same);
+}
+
+static void testPackCount() {
+    ParticleSystem ps(200, 2, 3);
+    Emitter e;
+    ps.addEmitter(e, 100);
+    e.pos.x += 2.0f;
+    ps.addEmitter(e, 100);
+    for (int f = 0; f < 120; ++f) ps.update(1.0f / 60.0f, f / 60.0f, true);
+    std::vector<GPUParticle> out(200);
+    int n = ps.pack(out.data());
+    CHECK(n == ps.liveCount());
+    CHECK(n > 0);
+    // second emitter's particles follow the first emitter's
+    CHECK(out[ps.emitters[0].count].px == ps.particles[100].pos.x);
+}
+
+static void testCulling() {
+    glm::mat4 proj = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 100.0f);
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 0.0f, 5.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    Frustum f = Frustum::fromMatrix(proj * view);
+    GPUParticle in[3] = {
+        { 0.0f, 0.0f, 0.0f, 0.1f, 0.5f },   // in front of the camera
+        { 0.0f, 0.0f, 10.0f, 0.1f, 0.5f },  // behind it
+        { 50.0f, 0.0f, 0.0f, 0.1f, 0.5f },  // far off to the side
+    };
+    GPUParticle out[3];
+    CullStats stats;
+    int n = cullParticles(in, 3, f, out, stats);
+    CHECK(n == 1);
+    CHECK(stats.tested == 3 && stats.visible == 1 && stats.culled == 2);
+    CHECK(out[0].pz == 0.0f);
+}
+
+static void testLodLevels() {
+    glm::vec3 camPos(0.0f), forward(0.0f, 0.0f, -1.0f), right(1.0f, 0.0f, 0.0f), up(0.0f, 1.0f, 0.0f);
+    const float pixelScale = 1000.0f;
+    std::vector<GPUParticle> data = {
+        { 0.0f, 0.0f, -5.0f, 0.5f, 0.3f },     // 200 px: full billboard
+        { 0.0f, 0.0f, -1000.0f, 0.5f, 0.3f },  // 1 px: point
+    };
+    ParticleLod lod(16);
+    LodSettings settings;
+    settings.enabled = true;
+    int billboards = lod.apply(settings, data.data(), (int)data.size(), camPos, forward, right, up, pixelScale);
+    CHECK(billboards == 1);
+    CHECK(lod.stats.full == 1);
+    CHECK(lod.stats.points == 1);
+
+    settings.enabled = false;
+    CHECK(lod.apply(settings, data.data(), 2, camPos, forward, right, up, pixelScale) == 2);
+}
+
+static void testSimLodStagger() {
+    // far away every particle is tier 3: updated every 8th frame, never starved
+    // by compaction or a Morton reorder moving it to another slot
+    const float dt = 1.0f / 60.0f;
+    ParticleSystem ps(1000, 1, 11);
+    Emitter e;
+    e.lifeSpan = 3.0f; // steady deaths, so survivors keep shifting down
+    ps.addEmitter(e, 1000);
+    ps.reorderInterval = 5;
+    ps.simLod.enabled = true;
+    ps.simLod.camPos = glm::vec3(0.0f, 0.0f, 200.0f);
+    const float bound = ((1 << (SIM_LOD_TIERS - 1)) - 1) * dt + 1e-5f;
+    float worst = 0.0f;
+    for (int f = 0; f < 60 * 20; ++f) {
+        ps.update(dt, f * dt, true);
+        for (int i = 0; i < ps.liveCount(); ++i) worst = std::max(worst, ps.particles[i].pendingDt);
+    }
+    CHECK(worst <= bound);
+    CHECK(ps.simLodStats.perTier[SIM_LOD_TIERS - 1] == ps.simLodStats.updated);
+    CHECK(ps.simLodStats.updated > 0);
+}
+
+static void testParticleBudget() {
+    ParticleSystem ps(400, 1, 5);
+    ps.addEmitter(Emitter(), 400);
+    Particle* before = ps.particles.data();
+    // particles die for real now, so a full slice sits within a couple of puffs of its cap
+    auto nearCap = [&](int cap) { return ps.liveCount() <= cap && ps.liveCount() > cap - 2 * ps.emitters[0].burst; };
+    for (int f = 0; f < 60 * 30; ++f) ps.update(1.0f / 60.0f, f / 60.0f, true);
+    CHECK(nearCap(400));
+
+    // lowered cap: the excess fades out over retireTime
+    ps.setBudget(0.25f);
+    CHECK(ps.liveCap(ps.emitters[0]) == 100);
+    for (int f = 0; f < 60 * 2; ++f) ps.update(1.0f / 60.0f, f / 60.0f, true);
+    CHECK(nearCap(100));
+
+    // raised again: refills by spawning, still in the same allocation
+    ps.setBudget(1.0f);
+    for (int f = 0; f < 60 * 30; ++f) ps.update(1.0f / 60.0f, f / 60.0f, true);
+    CHECK(nearCap(400));
+    CHECK(ps.particles.data() == before);
+}
+
+static void testLifetimesAndCompaction() {
+    // every particle lives within lifeSpan * [1 - jitter, 1 + jitter]
+    Emitter e;
+    Rng rng(11);
+    Particle p;
+    float shortest = 1e9f, longest = 0.0f;
+    for (int i = 0; i < 10000; ++i) {
+        respawnParticle(p, e, 0, rng);
+        shortest = std::min(shortest, 1.0f / p.invLifeSpan);
+        longest = std::max(longest, 1.0f / p.invLifeSpan);
+    }
+    CHECK(shortest >= e.lifeSpan * (1.0f - e.lifeSpanJitter) - 1e-3f);
+    CHECK(longest <= e.lifeSpan * (1.0f + e.lifeSpanJitter) + 1e-3f);
+    CHECK(longest - shortest > e.lifeSpan * e.lifeSpanJitter);
+
+    // the parallel prefix-sum compaction gives exactly the serial result
+    const int n = 100000;
+    ThreadPool pool(4);
+    ParticleSystem serial(n, 1, 21), parallel(n, 1, 21);
+    parallel.setThreadPool(&pool);
+    Emitter fast;
+    fast.burst = 2000;
+    fast.spawnInterval = 0.0f;
+    fast.lifeSpan = 1.0f;
+    serial.addEmitter(fast, n);
+    parallel.addEmitter(fast, n);
+    bool same = true, dense = true;
+    for (int f = 0; f < 180; ++f) {
+        serial.update(1.0f / 60.0f, f / 60.0f, true);
+        parallel.update(1.0f / 60.0f, f / 60.0f, true);
+        same = same && serial.liveCount() == parallel.liveCount();
+        for (int i = 0; same && i < serial.liveCount(); ++i)
+            same = serial.particles[i].pos == parallel.particles[i].pos && serial.particles[i].life == parallel.particles[i].life;
+        for (int i = 0; i < parallel.liveCount(); ++i) dense = dense && parallel.particles[i].life < 1.0f;
+    }
+    CHECK(same);
+    CHECK(dense);
+    CHECK(parallel.liveCount() > ParticleSystem::PARALLEL_COMPACT_MIN); // the parallel path actually ran
+}
+
+static void testRingLayout() {
+    // with one lifetime the ring holds exactly what compaction keeps, in the same order
+    const int n = 300;
+    ParticleSystem compact(n, 1, 5), ring(n, 1, 5);
+    Emitter e;
+    e.burst = 12;
+    e.spawnInterval = 0.0f;
+    e.lifeSpan = 0.5f;
+    e.lifeSpanJitter = 0.0f;
+    compact.addEmitter(e, n);
+    ring.addEmitter(e, n);
+    ring.setLayout(PoolLayout::Ring);
+    std::vector<GPUParticle> a(n), b(n);
+    bool same = true, wrapped = false;
+    for (int f = 0; f < 240; ++f) {
+        float budget = f < 120 ? 1.0f : 0.4f; // shrinking retires from the head as well
+        compact.setBudget(budget);
+        ring.setBudget(budget);
+        compact.update(1.0f / 60.0f, f / 60.0f, true);
+        ring.update(1.0f / 60.0f, f / 60.0f, true);
+        int ca = compact.pack(a.data()), cb = ring.pack(b.data());
+        same = same && ca == cb;
+        for (int i = 0; same && i < ca; ++i)
+            same = a[i].px == b[i].px && a[i].py == b[i].py && a[i].life == b[i].life;
+        ParticleSpan runs[2];
+        wrapped = wrapped || ring.spans(ring.emitters[0], runs) == 2;
+    }
+    CHECK(same);
+    CHECK(wrapped);
+    CHECK(ring.liveCount() <= n);
+
+    // switching back rotates the live run to the front of the slice
+    int live = ring.liveCount();
+    ring.setLayout(PoolLayout::Compact);
+    ParticleSpan runs[2];
+    CHECK(ring.spans(ring.emitters[0], runs) == 1);
+    CHECK(runs[0].data == ring.particles.data() && runs[0].count == live);
+    int cb = ring.pack(b.data());
+    same = cb == compact.pack(a.data());
+    for (int i = 0; same && i < cb; ++i) same = a[i].px == b[i].px && a[i].life == b[i].life;
+    CHECK(same);
+}
+
+static void testMortonOrder() {
+    // the cached noise is bit-identical to the plain one, hit or miss
+    Rng r(3);
+    NoiseCache cache;
+    bool same = true;
+    for (int i = 0; i < 10000; ++i) {
+        glm::vec3 p(r.uniform() * 3.0f, r.uniform() * 3.0f, r.uniform() * 3.0f);
+        same = same && noiseVelocity(p, 1.5f, cache) == noiseVelocity(p, 1.5f);
+    }
+    CHECK(same);
+
+    // reordering only permutes each slice: the same particles live and die,
+    // and over a lowered budget the same (oldest) ones are retired
+    const int n = 400;
+    ParticleSystem plain(n, 2, 9), sorted(n, 2, 9);
+    Emitter e;
+    e.burst = 1; // one spawn time per particle, so ages never tie
+    e.spawnInterval = 0.05f;
+    e.lifeSpan = 6.0f;
+    Emitter beside = e;
+    beside.pos.x += 2.0f;
+    for (ParticleSystem* ps : { &plain, &sorted }) {
+        ps->addEmitter(e, n / 2);
+        ps->addEmitter(beside, n / 2);
+    }
+    sorted.reorderInterval = 7;
+    auto key = [](const GPUParticle& g) { return std::make_tuple(g.px, g.py, g.pz, g.size, g.life); };
+    auto sortedPack = [&](const ParticleSystem& ps, std::vector<GPUParticle>& out) {
+        out.resize(n);
+        out.resize(ps.pack(out.data()));
+        std::sort(out.begin(), out.end(), [&](const GPUParticle& a, const GPUParticle& b) { return key(a) < key(b); });
+    };
+    std::vector<GPUParticle> a, b;
+    bool permuted = false;
+    for (int f = 0; f < 60 * 12; ++f) {
+        float budget = f < 60 * 8 ? 1.0f : 0.5f;
+        plain.setBudget(budget);
+        sorted.setBudget(budget);
+        plain.update(1.0f / 60.0f, f / 60.0f, true);
+        sorted.update(1.0f / 60.0f, f / 60.0f, true);
+        sortedPack(plain, a);
+        sortedPack(sorted, b);
+        same = same && a.size() == b.size();
+        for (size_t i = 0; same && i < a.size(); ++i) same = key(a[i]) == key(b[i]);
+        permuted = permuted || sorted.particles[0].pos != plain.particles[0].pos;
+    }
+    CHECK(same);
+    CHECK(permuted);
+
+    // neighbours in memory end up close in space
+    auto pathLength = [](const ParticleSystem& ps) {
+        float length = 0.0f;
+        for (int i = 1; i < ps.emitters[0].count; ++i) length += glm::length(ps.particles[i].pos - ps.particles[i - 1].pos);
+        return length;
+    };
+    ParticleSystem random(2000, 1, 4);
+    Emitter burst;
+    burst.burst = 2000;
+    burst.spawnInterval = 0.0f;
+    random.addEmitter(burst, 2000);
+    random.update(1.0f / 60.0f, 0.0f, true);
+    Rng jitter(8);
+    for (Particle& p : random.particles) p.pos += glm::vec3(jitter.uniform(), jitter.uniform(), jitter.uniform()) * 4.0f;
+    float before = pathLength(random);
+    random.reorder();
+    CHECK(random.emitters[0].count == 2000);
+    CHECK(pathLength(random) < before * 0.25f);
+}
+
+static void testEmitterMotion() {
+    // two runs of the same seed at different noise times; only the flow reads the time
+    auto run = [](EmitterMotion motion, float timeOffset) {
+        ParticleSystem ps(200, 1, 17);
+        Emitter e;
+        e.motion = motion;
+        ps.addEmitter(e, 200);
+        for (int f = 0; f < 120; ++f) ps.update(1.0f / 60.0f, f / 60.0f + timeOffset, true);
+        std::vector<GPUParticle> out(200);
+        out.resize(ps.pack(out.data()));
+        return out;
+    };
+    auto same = [](const std::vector<GPUParticle>& a, const std::vector<GPUParticle>& b) {
+        bool equal = a.size() == b.size();
+        for (size_t i = 0; equal && i < a.size(); ++i) equal = a[i].px == b[i].px && a[i].pz == b[i].pz;
+        return equal;
+    };
+    CHECK(!same(run(EmitterMotion::Plume, 0.0f), run(EmitterMotion::Plume, 5.0f)));
+    CHECK(same(run(EmitterMotion::Calm, 0.0f), run(EmitterMotion::Calm, 5.0f)));
+
+    // a jet neither spreads nor grows: it stays on its axis at spawn size
+    Emitter e;
+    std::vector<GPUParticle> calm = run(EmitterMotion::Calm, 0.0f), jet = run(EmitterMotion::Jet, 0.0f);
+    float calmOff = 0.0f, jetOff = 0.0f;
+    bool spawnSize = true;
+    for (const GPUParticle& g : calm) calmOff = std::max(calmOff, std::hypot(g.px - e.pos.x, g.pz - e.pos.z));
+    for (const GPUParticle& g : jet) {
+        jetOff = std::max(jetOff, std::hypot(g.px - e.pos.x, g.pz - e.pos.z));
+        spawnSize = spawnSize && g.size >= e.sizeBase * 0.8f - 1e-6f && g.size <= e.sizeBase * 1.2f + 1e-6f;
+    }
+    CHECK(spawnSize);
+    CHECK(jetOff < e.spawnRadius + 0.05f);
+    CHECK(calmOff > jetOff * 2.0f);
+}
+
+static void testEmitterCodegen() {
+    // curves: linear between keys, flat outside, baked endpoints inclusive
+    Curve c = { { { 0.25f, 1.0f }, { 0.75f, 3.0f } } };
+    CHECK(c.eval(0.0f) == 1.0f && c.eval(1.0f) == 3.0f);
+    CHECK(std::fabs(c.eval(0.5f) - 2.0f) < 1e-6f);
+    CHECK(Curve().eval(0.3f) == 1.0f);
+    std::vector<float> lut = bakeCurve(GpuEmitterType().alphaOverLife, 5);
+    CHECK(lut.size() == 5 && lut.front() == 1.0f && lut.back() == 0.0f && std::fabs(lut[2] - 0.5f) < 1e-6f);
+
+    // parameters share a program, modules don't
+    GpuEmitterType a, b = a;
+    b.spawnRate *= 2.0f;
+    b.sizeOverLife.keys.clear();
+    CHECK(programKey(a) == programKey(b));
+    CHECK(b.capacity() > a.capacity());
+    b.shape = SpawnShape::Sphere;
+    CHECK(programKey(a) != programKey(b));
+    b = a;
+    b.trackBounds = true;
+    CHECK(programKey(a) != programKey(b));
+
+    // each kernel holds only its modules' code
+    GpuEmitterType calm;
+    calm.forces = GPU_FORCE_DRIFT | GPU_FORCE_DAMPING;
+    CHECK(programKey(a) != programKey(calm));
+    std::string plume = generateEmitterShader(a), calmSrc = generateEmitterShader(calm), tracked = generateEmitterShader(b);
+    CHECK(plume.find("noiseVelocity") != std::string::npos);
+    CHECK(calmSrc.find("noiseVelocity") == std::string::npos && calmSrc.find("horizontalSpread *") == std::string::npos);
+    CHECK(plume.find("atomicMin") == std::string::npos && tracked.find("atomicMin") != std::string::npos);
+}
+
+static void testAllocationTracking() {
+    if (!AllocTracker::enabled()) {
+        CHECK(AllocTracker::total().allocations == 0 && AllocTracker::steadyAllocations() == 0);
+        return;
+    }
+    // counted on every path into operator new; kept alive so it can't be elided
+    static std::vector<std::vector<int>> kept;
+    AllocCounts before = AllocTracker::total();
+    kept.emplace_back(1000);
+    AllocCounts after = AllocTracker::total();
+    CHECK(after.allocations > before.allocations && after.bytes >= before.bytes + 1000 * sizeof(int));
+
+    // once the pool, compaction scratch and sort buffers exist, updates don't allocate
+    ThreadPool pool(3);
+    ParticleSystem ps(3000, 2, 9);
+    ps.setThreadPool(&pool);
+    ps.reorderInterval = 10;
+    Emitter a, b;
+    b.pos.x += 1.5f;
+    ps.addEmitter(a, 1500);
+    ps.addEmitter(b, 1500);
+    for (int f = 0; f < 60; ++f) ps.update(1.0f / 60.0f, f / 60.0f, true);
+    before = AllocTracker::total();
+    for (int f = 60; f < 600; ++f) ps.update(1.0f / 60.0f, f / 60.0f, true);
+    CHECK(AllocTracker::total().allocations == before.allocations);
+}
+
+static void testGlRegistry() {
+    // names as a driver would hand them out; the registry itself makes no GL calls
+    GlRegistry::Totals start = GlRegistry::totals();
+    GlRegistry::add(GlKind::Texture, 7, "test smoke texture");
+    GlRegistry::add(GlKind::Buffer, 7, "test particles");
+    GlRegistry::setBytes(GlKind::Texture, 7, 4096);
+    GlRegistry::setBytes(GlKind::Buffer, 7, 1024);
+    CHECK(GlRegistry::totals().count == start.count + 2);
+    CHECK(GlRegistry::totals().bytes == start.bytes + 5120);
+    CHECK(GlRegistry::totals(GlKind::Texture).bytes == 4096);
+    CHECK(GlRegistry::peakBytes() >= start.bytes + 5120);
+
+    // resizing replaces the old size, a reused name replaces the stale entry
+    GlRegistry::setBytes(GlKind::Buffer, 7, 2048);
+    GlRegistry::add(GlKind::Texture, 7, "test smoke texture");
+    CHECK(GlRegistry::totals().bytes == start.bytes + 2048);
+
+    std::ostringstream report;
+    CHECK(GlRegistry::reportLeaks(report) == start.count + 2);
+    CHECK(report.str().find("buffer 7, 2048 bytes, from test particles") != std::string::npos);
+
+    GlRegistry::remove(GlKind::Texture, 7);
+    GlRegistry::remove(GlKind::Buffer, 7);
+    GlRegistry::remove(GlKind::Buffer, 7); // already gone
+    CHECK(GlRegistry::totals().count == start.count && GlRegistry::totals().bytes == start.bytes);
+}
+
+static void testPrewarm() {
+    // 22 s fast-forwarded at a coarse step looks like 22 s of 60 Hz frames
+    ParticleSystem warm(2000, 1, 3), real(2000, 1, 3);
+    warm.addEmitter(Emitter(), 2000);
+    real.addEmitter(Emitter(), 2000);
+    PrewarmStats stats = warm.prewarm(22.0f, 0.1f, 22.0f);
+    for (int f = 1; f <= 22 * 60; ++f) real.update(1.0f / 60.0f, f / 60.0f, true);
+    CHECK(stats.steps == 220);
+    CHECK(stats.threads == 1); // no pool
+    CHECK(std::fabs(stats.simulated - 22.0f) < 1e-3f);
+    CHECK(std::abs(warm.liveCount() - real.liveCount()) <= real.liveCount() / 20);
+    auto meanHeight = [](const ParticleSystem& ps) {
+        float sum = 0.0f;
+        for (int i = 0; i < ps.liveCount(); ++i) sum += ps.particles[i].pos.y;
+        return sum / ps.liveCount();
+    };
+    CHECK(std::fabs(meanHeight(warm) - meanHeight(real)) < 0.1f * meanHeight(real));
+
+    // only slices past PARALLEL_UPDATE_MIN are split across the pool
+    ThreadPool pool(3);
+    warm.setThreadPool(&pool);
+    CHECK(warm.prewarm(1.0f, 0.1f, 23.0f).threads == 1);
+    ParticleSystem dense(8192, 1, 3);
+    dense.setThreadPool(&pool);
+    Emitter thick;
+    thick.burst = 400;
+    thick.spawnInterval = 0.02f;
+    dense.addEmitter(thick, 8192);
+    CHECK(dense.prewarm(2.0f, 0.1f, 2.0f).threads == 3);
+
+    // the wall-time cap stops it early
+    ParticleSystem capped(2000, 1, 3);
+    capped.addEmitter(Emitter(), 2000);
+    stats = capped.prewarm(1000.0f, 0.1f, 0.0f, 1e-3f);
+    CHECK(stats.steps >= 1 && stats.steps < 10000);
+    CHECK(stats.simulated < 1000.0f);
+}
+
+static void testStateFile() {
+    // a restored system continues exactly like the one that was saved
+    const char* path = "smoke_tests_state.bin";
+    ParticleSystem original(3000, 4, 9);
+    Emitter a, b;
+    b.pos.x += 1.5f;
+    original.addEmitter(a, 1000);
+    original.addEmitter(b, 1000);
+    original.setLayout(PoolLayout::Ring);
+    original.setBudget(0.8f);
+    for (int f = 0; f < 400; ++f) original.update(1.0f / 60.0f, f / 60.0f, true);
+    CHECK(original.saveState(path, 400 / 60.0f));
+
+    ParticleSystem restored(4000, 4, 1234);
+    float simTime = 0.0f;
+    CHECK(restored.loadState(path, &simTime));
+    CHECK(simTime == 400 / 60.0f);
+    CHECK(restored.emitters.size() == 2 && restored.liveCount() == original.liveCount());
+    CHECK(restored.layout() == PoolLayout::Ring && restored.budget() == original.budget());
+    std::vector<GPUParticle> x(3000), y(4000);
+    bool same = true;
+    for (int f = 400; f < 700; ++f) {
+        original.update(1.0f / 60.0f, f / 60.0f, true);
+        restored.update(1.0f / 60.0f, f / 60.0f, true);
+        int nx = original.pack(x.data()), ny = restored.pack(y.data());
+        same = same && nx == ny;
+        for (int i = 0; same && i < nx; ++i)
+            same = x[i].px == y[i].px && x[i].py == y[i].py && x[i].life == y[i].life;
+    }
+    CHECK(same);
+
+    // too small a pool or a damaged file is rejected without touching the system
+    ParticleSystem small(1500);
+    CHECK(!small.loadState(path));
+    CHECK(small.emitters.empty());
+    {
+        std::vector<char> bytes;
+        std::ifstream in(path, std::ios::binary);
+        bytes.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        in.close();
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out.write(bytes.data(), bytes.size() - 1);
+    }
+    int live = restored.liveCount();
+    CHECK(!restored.loadState(path));
+    CHECK(restored.liveCount() == live);
+
+    // so is a budget outside (0, 1]
+    CHECK(original.saveState(path, 0.0f));
+    {
+        std::vector<char> bytes;
+        std::ifstream in(path, std::ios::binary);
+        bytes.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        in.close();
+        const float saved = 0.8f, zero = 0.0f;
+        auto at = std::search(bytes.begin(), bytes.begin() + 64, (const char*)&saved, (const char*)&saved + sizeof(saved));
+        CHECK(at != bytes.begin() + 64);
+        if (at != bytes.begin() + 64) std::memcpy(&*at, &zero, sizeof(zero));
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out.write(bytes.data(), bytes.size());
+    }
+    CHECK(!restored.loadState(path));
+    CHECK(restored.liveCount() == live);
+    CHECK(!restored.loadState("does_not_exist.bin"));
+    std::remove(path);
+}
+
+static void testRecording() {
+    // a recording plays back every frame within the quantization step, and seeks
+    const char* path = "smoke_tests_recording.rec";
+    ParticleSystem smoke(4000, 1, 17);
+    smoke.addEmitter(Emitter(), 4000);
+    std::vector<std::vector<GPUParticle>> frames;
+    ParticleRecorder recorder;
+    CHECK(recorder.open(path, 16));
+    std::vector<GPUParticle> packed(4000);
+    for (int f = 0; f < 200; ++f) {
+        smoke.update(1.0f / 60.0f, f / 60.0f, true);
+        int n = smoke.pack(packed.data());
+        frames.emplace_back(packed.begin(), packed.begin() + n);
+        CHECK(recorder.addFrame(packed.data(), n, f / 60.0f));
+    }
+    CHECK(recorder.close());
+    CHECK(recorder.fileBytes() * 3 < recorder.rawBytes());
+
+    ParticlePlayer player;
+    CHECK(player.open(path));
+    CHECK(player.frameCount() == 200);
+    CHECK(player.maxParticles() == (int)frames.back().size());
+    CHECK(player.frameAt(100 / 60.0f + 1e-4f) == 100);
+    StreamQuantization q;
+    auto matches = [&](int f) {
+        int n;
+        const GPUParticle* p = player.frame(f, &n);
+        if (!p || n != (int)frames[f].size()) return false;
+        for (int i = 0; i < n; ++i) {
+            const GPUParticle& a = frames[f][i];
+            if (std::fabs(p[i].px - a.px) > q.posStep || std::fabs(p[i].py - a.py) > q.posStep
+                || std::fabs(p[i].pz - a.pz) > q.posStep || std::fabs(p[i].size - a.size) > q.sizeStep
+                || std::fabs(p[i].life - a.life) > 1.0f / 65535.0f)
+                return false;
+        }
+        return true;
+    };
+    bool all = true;
+    for (int f = 0; f < 200; ++f) all = all && matches(f);
+    CHECK(all);
+    CHECK(matches(150) && matches(37) && matches(38) && matches(199) && matches(0));
+    std::remove(path);
+}
+
+static void testImageWriter() {
+    // 5x3 gradient, GL order (bottom row first)
+    const int w = 5, h = 3;
+    std::vector<unsigned char> pixels(w * h * 4);
+    for (size_t i = 0; i < pixels.size(); ++i) pixels[i] = (unsigned char)(i * 7 + 3);
+    const std::vector<unsigned char> original = pixels;
+
+    ImageWriter writer(2);
+    for (int i = 0; i < 4; ++i) {
+        std::vector<unsigned char> copy = original;
+        writer.push("smoke_tests_image_" + std::to_string(i) + ".raw", w, h, copy, ImageFormat::Raw);
+        CHECK(copy.empty());
+    }
+    writer.push("smoke_tests_image.png", w, h, pixels, ImageFormat::Png);
+    writer.finish();
+#if SMOKE_HAVE_ZLIB
+    CHECK(writer.written() == 5 && writer.failed() == 0);
+#else
+    CHECK(writer.written() == 4 && writer.failed() == 1);
+#endif
+
+    // raw files are the rows top first
+    std::ifstream raw("smoke_tests_image_3.raw", std::ios::binary);
+    std::vector<unsigned char> rawBytes((std::istreambuf_iterator<char>(raw)), std::istreambuf_iterator<char>());
+    raw.close();
+    bool flipped = rawBytes.size() == original.size();
+    for (int y = 0; flipped && y < h; ++y)
+        flipped = std::equal(&rawBytes[y * w * 4], &rawBytes[y * w * 4] + w * 4, &original[(h - 1 - y) * w * 4]);
+    CHECK(flipped);
+    for (int i = 0; i < 4; ++i) std::remove(("smoke_tests_image_" + std::to_string(i) + ".raw").c_str());
+
+#if SMOKE_HAVE_ZLIB
+    // walk the PNG chunks, check their CRCs, inflate IDAT and undo the Sub filter
+    std::ifstream in("smoke_tests_image.png", std::ios::binary);
+    std::vector<unsigned char> png((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    in.close();
+    auto be32 = [&](size_t at) { return (uint32_t)png[at] << 24 | (uint32_t)png[at + 1] << 16 | (uint32_t)png[at + 2] << 8 | png[at + 3]; };
+    CHECK(png.size() > 8 && std::memcmp(png.data(), "\x89PNG\r\n\x1a\n", 8) == 0);
+    std::vector<unsigned char> idat;
+    bool crcOk = true, sawEnd = false;
+    for (size_t at = 8; at + 12 <= png.size() && !sawEnd;) {
+        uint32_t len = be32(at);
+        std::string type(png.begin() + at + 4, png.begin() + at + 8);
+        crcOk = crcOk && crc32(0, &png[at + 4], len + 4) == be32(at + 8 + len);
+        if (type == "IHDR") CHECK(be32(at + 8) == (uint32_t)w && be32(at + 12) == (uint32_t)h && png[at + 16] == 8 && png[at + 17] == 6);
+        if (type == "IDAT") idat.insert(idat.end(), png.begin() + at + 8, png.begin() + at + 8 + len);
+        sawEnd = type == "IEND";
+        at += 12 + len;
+    }
+    CHECK(crcOk && sawEnd);
+    std::vector<unsigned char> rows((w * 4 + 1) * h);
+    uLongf rowBytes = rows.size();
+    CHECK(uncompress(rows.data(), &rowBytes, idat.data(), idat.size()) == Z_OK && rowBytes == rows.size());
+    bool same = true;
+    for (int y = 0; y < h; ++y) {
+        unsigned char* r = &rows[(w * 4 + 1) * y];
+        same = same && r[0] == 1;
+        for (int i = 4; i < w * 4; ++i) r[1 + i] = (unsigned char)(r[1 + i] + r[1 + i - 4]);
+        same = same && std::equal(r + 1, r + 1 + w * 4, &original[(h - 1 - y) * w * 4]);
+    }
+    CHECK(same);
+#endif
+    std::remove("smoke_tests_image.png");
+}
+
+static void testSplatRenderer() {
+    // flat texture: every texel the same, so the expected colour is the blend rule alone
+    const unsigned char texel[4] = { 200, 100, 50, 128 };
+    std::vector<unsigned char> flat(16 * 16 * 4);
+    for (size_t i = 0; i < flat.size(); ++i) flat[i] = texel[i % 4];
+    SplatRenderer splatter(16);
+    splatter.setTexture(16, 16, flat.data());
+
+    // orthographic, one pixel per 1/32 unit: a particle of size 0.25 at the
+    // origin covers pixels 24..39 of a 64x64 image
+    SplatCamera cam;
+    cam.projection = glm::ortho(-1.0f, 1.0f, -1.0f, 1.0f, 0.1f, 10.0f);
+    cam.width = cam.height = 64;
+    SplatImage image;
+    auto pixel = [&](int x, int y) { return image.pixels[(size_t)y * image.width + x]; };
+    auto near = [](glm::vec4 a, glm::vec4 b) { return glm::all(glm::lessThan(glm::abs(a - b), glm::vec4(1e-4f))); };
+    const glm::vec3 color = glm::mix(glm::vec3(1.0f), splatter.tint, 0.2f) * glm::vec3(200, 100, 50) / 255.0f;
+    auto over = [&](glm::vec4 dst, float life) {
+        float a = 128.0f / 255.0f * (1.0f - life);
+        return glm::vec4(color * a + glm::vec3(dst) * (1.0f - a), a * a + dst.a * (1.0f - a));
+    };
+
+    GPUParticle one = { 0.0f, 0.0f, -1.0f, 0.25f, 0.3f };
+    splatter.render(&one, 1, cam, image);
+    CHECK(image.width == 64 && image.height == 64 && image.pixels.size() == 64 * 64);
+    CHECK(near(pixel(32, 32), over(splatter.clearColor, 0.3f)));
+    CHECK(near(pixel(24, 24), pixel(32, 32)) && near(pixel(39, 39), pixel(32, 32)));
+    CHECK(pixel(23, 32) == splatter.clearColor && pixel(40, 32) == splatter.clearColor && pixel(5, 5) == splatter.clearColor);
+    CHECK(splatter.stats().splats == 1 && splatter.stats().binned == 4);
+
+    // off screen, behind the camera, or fully faded: nothing drawn
+    GPUParticle hidden[3] = { { 5.0f, 0.0f, -1.0f, 0.25f, 0.0f }, { 0.0f, 0.0f, 1.0f, 0.25f, 0.0f }, { 0.0f, 0.0f, -1.0f, 0.25f, 1.0f } };
+    splatter.render(hidden, 3, cam, image);
+    CHECK(splatter.stats().splats == 0);
+    CHECK(std::all_of(image.pixels.begin(), image.pixels.end(), [&](const glm::vec4& c) { return c == splatter.clearColor; }));
+
+    // overlapping particles blend in buffer order, like the GL draw
+    GPUParticle pair[2] = { { 0.0f, 0.0f, -1.0f, 0.25f, 0.1f }, { 0.1f, 0.0f, -1.0f, 0.25f, 0.6f } };
+    splatter.render(pair, 2, cam, image);
+    CHECK(near(pixel(33, 32), over(over(splatter.clearColor, 0.1f), 0.6f)));
+    std::swap(pair[0], pair[1]);
+    splatter.render(pair, 2, cam, image);
+    CHECK(near(pixel(33, 32), over(over(splatter.clearColor, 0.6f), 0.1f)));
+
+    // a real plume through a perspective camera and a patterned texture:
+    // the threaded renderer matches the serial one bit for bit
+    std::vector<unsigned char> pattern(64 * 64 * 4);
+    for (size_t i = 0; i < pattern.size(); ++i) pattern[i] = (unsigned char)(i * 37 + (i >> 7) * 11);
+    ParticleSystem smoke(20000, 1, 3);
+    Emitter dense;
+    dense.pos = glm::vec3(0.0f, 0.0f, -1.0f);
+    dense.spawnInterval = 0.01f;
+    dense.burst = 16;
+    smoke.addEmitter(dense, 20000);
+    for (int f = 0; f < 240; ++f) smoke.update(1.0f / 60.0f, f / 60.0f, true);
+    std::vector<GPUParticle> packed(20000);
+    int live = smoke.pack(packed.data());
+    cam.view = glm::lookAt(glm::vec3(0.0f, 2.0f, 6.0f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    cam.projection = glm::perspective(glm::radians(45.0f), 160.0f / 90.0f, 0.1f, 100.0f);
+    cam.width = 160;
+    cam.height = 90;
+    SplatRenderer serial(16), threaded(16);
+    serial.setTexture(64, 64, pattern.data());
+    threaded.setTexture(64, 64, pattern.data());
+    ThreadPool pool(4);
+    threaded.setThreadPool(&pool);
+    SplatImage a, b;
+    serial.render(packed.data(), live, cam, a);
+    threaded.render(packed.data(), live, cam, b);
+    CHECK(live > 1000 && serial.stats().splats > 1000);
+    CHECK(a.pixels == b.pixels);
+    CHECK(std::any_of(a.pixels.begin(), a.pixels.end(), [&](const glm::vec4& c) { return c != serial.clearColor; }));
+}
+
+static void testBudgetController() {
+    BudgetSettings s;
+    s.enabled = true;
+    s.targetMs = 10.0f;
+    s.smoothing = 1.0f; // no smoothing, so each sample acts directly
+    BudgetController c;
+
+    // over budget: multiplicative cuts down to the floor
+    for (int i = 0; i < 100; ++i) c.update(s, 20.0f, s.interval);
+    CHECK(c.fraction == s.minFraction);
+
+    // inside the deadband: no change either way
+    float held = c.fraction;
+    for (int i = 0; i < 100; ++i) c.update(s, 10.5f, s.interval);
+    CHECK(c.fraction == held);
+
+    // under budget: additive growth up to the ceiling
+    for (int i = 0; i < 1000; ++i) c.update(s, 2.0f, s.interval);
+    CHECK(c.fraction == s.maxFraction);
+
+    // no growth right after a cut
+    c.update(s, 20.0f, s.interval);
+    float cut = c.fraction;
+    c.update(s, 2.0f, s.interval);
+    CHECK(c.fraction == cut);
+}
+
+static void testResolutionController() {
+    DynamicResolutionSettings s;
+    s.enabled = true;
+    s.targetMs = 8.0f;
+    ResolutionController c;
+
+    // GPU time proportional to the pixel count: settles where scale^2 * 16 ms hits the target
+    for (int i = 0; i < 500; ++i) c.update(s, 16.0f * c.scale * c.scale);
+    CHECK(std::fabs(c.smoothedMs - s.targetMs) <= s.targetMs * s.deadband);
+    CHECK(c.scale < 0.8f && c.scale > 0.6f);
+    CHECK(c.renderSize(s, 2160) % 108 == 0); // 2160 * 0.05 quantum
+
+    // cheap frames go back up to full resolution, never past it
+    for (int i = 0; i < 500; ++i) c.update(s, 2.0f);
+    CHECK(c.scale == s.maxScale);
+    CHECK(c.renderSize(s, 720) == 720);
+
+    // no measurement: scale holds
+    float held = c.scale;
+    c.update(s, 0.0f);
+    CHECK(c.scale == held);
+}
+
+static void testTripleBuffer() {
+    // single-threaded: the reader always gets the newest publish, skipped ones count as dropped
+    TripleBuffer<int> tb(0);
+    bool fresh = true;
+    CHECK(tb.read(&fresh) == 0 && !fresh);
+    tb.writeBuffer() = 1; tb.publish();
+    tb.writeBuffer() = 2; tb.publish();
+    CHECK(tb.read(&fresh) == 2 && fresh);
+    CHECK(tb.read(&fresh) == 2 && !fresh);
+    CHECK(tb.droppedCount() == 1);
+    CHECK(tb.duplicatedCount() == 2);
+
+    // two threads: values only move forward, and every publish is either read or dropped
+    TripleBuffer<uint64_t> shared(0);
+    const uint64_t N = 200000;
+    std::thread producer([&] {
+        for (uint64_t i = 1; i <= N; ++i) {
+            shared.writeBuffer() = i;
+            shared.publish();
+        }
+    });
+    uint64_t last = 0, received = 0;
+    bool monotonic = true;
+    while (last != N) {
+        uint64_t v = shared.read(&fresh);
+        if (fresh) {
+            monotonic = monotonic && v > last;
+            last = v;
+            ++received;
+        }
+    }
+    producer.join();
+    CHECK(monotonic);
+    CHECK(received + shared.droppedCount() == N);
+}
+
+// ---------- Runner ----------
+int main() {
+    initNoise();
+    struct { const char* name; void (*fn)(); } tests[] = {
+        { "rng determinism", testRngDeterminism },
+        { "perlin range", testPerlinRange },
+        { "emitter slices", testEmitterSlices },
+        { "update determinism", testUpdateIsDeterministic },
+        { "pack count", testPackCount },
+        { "culling", testCulling },
+        { "lod levels", testLodLevels },
+        { "sim lod stagger", testSimLodStagger },
+        { "particle budget", testParticleBudget },
+        { "budget controller", testBudgetController },
+        { "lifetimes and compaction", testLifetimesAndCompaction },
+        { "ring layout", testRingLayout },
+        { "morton order", testMortonOrder },
+        { "emitter motion", testEmitterMotion },
+        { "emitter codegen", testEmitterCodegen },
+        { "allocation tracking", testAllocationTracking },
+        { "gl registry", testGlRegistry },
+        { "prewarm", testPrewarm },
+        { "state file", testStateFile },
+        { "recording", testRecording },
+        { "image writer", testImageWriter },
+        { "splat renderer", testSplatRenderer },
+        { "resolution controller", testResolutionController },
+        { "triple buffer", testTripleBuffer },
+    };
+    int failed = 0;
+    for (const auto& t : tests) {
+        int before = checksFailed;
+        t.fn();
+        bool ok = checksFailed == before;
+        std::printf("[%s] %s\n", ok ? " OK " : "FAIL", t.name);
+        if (!ok) ++failed;
+    }
+    std::printf("%d of %d tests failed\n", failed, (int)(sizeof(tests) / sizeof(tests[0])));
+    return failed;
+}
@@ -0,0 +1,10 @@
+#version 450 core
+// puts the tiled smoke image over the scene (blend ONE, ONE_MINUS_SRC_ALPHA)
+out vec4 FragColor;
+
+uniform sampler2D smokeImage;
+uniform ivec2 viewportOrigin;
+
+void main() {
+    FragColor = texelFetch(smokeImage, ivec2(gl_FragCoord.xy) - viewportOrigin, 0);
+}
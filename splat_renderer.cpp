@@ -0,0 +1,178 @@
+#include "splat_renderer.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include "stb_image.h"
+#include "thread_pool.h"
+
+static const int SPLAT_BLOCK = 4096; // particles projected per task
+
+void SplatImage::toRgba8(std::vector<unsigned char>& out) const {
+    out.resize(pixels.size() * 4);
+    for (size_t i = 0; i < pixels.size(); ++i) {
+        glm::vec4 c = glm::clamp(pixels[i], 0.0f, 1.0f) * 255.0f + 0.5f;
+        out[i * 4 + 0] = (unsigned char)c.r;
+        out[i * 4 + 1] = (unsigned char)c.g;
+        out[i * 4 + 2] = (unsigned char)c.b;
+        out[i * 4 + 3] = (unsigned char)c.a;
+    }
+}
+
+bool SplatRenderer::loadTexture(const std::string& path) {
+    int w, h, c;
+    stbi_set_flip_vertically_on_load(true); // same orientation as the GL texture
+    unsigned char* data = stbi_load(path.c_str(), &w, &h, &c, 4);
+    if (!data) { std::cerr << "Failed to load " << path << "\n"; return false; }
+    setTexture(w, h, data);
+    stbi_image_free(data);
+    return true;
+}
+
+void SplatRenderer::setTexture(int w, int h, const unsigned char* rgba) {
+    // level 0 as floats, then 2x2 box-filtered levels down to 1x1, like glGenerateMipmap
+    mips.assign(1, MipLevel{ w, h, std::vector<glm::vec4>((size_t)w * h) });
+    for (size_t i = 0; i < mips[0].texels.size(); ++i)
+        mips[0].texels[i] = glm::vec4(rgba[i * 4], rgba[i * 4 + 1], rgba[i * 4 + 2], rgba[i * 4 + 3]) * (1.0f / 255.0f);
+    while (mips.back().width > 1 || mips.back().height > 1) {
+        const MipLevel& src = mips.back();
+        MipLevel dst{ std::max(1, src.width / 2), std::max(1, src.height / 2), {} };
+        dst.texels.resize((size_t)dst.width * dst.height);
+        for (int y = 0; y < dst.height; ++y)
+            for (int x = 0; x < dst.width; ++x) {
+                int x0 = std::min(x * 2, src.width - 1), x1 = std::min(x * 2 + 1, src.width - 1);
+                int y0 = std::min(y * 2, src.height - 1), y1 = std::min(y * 2 + 1, src.height - 1);
+                dst.texels[(size_t)y * dst.width + x] = 0.25f * (src.texels[(size_t)y0 * src.width + x0]
+                    + src.texels[(size_t)y0 * src.width + x1] + src.texels[(size_t)y1 * src.width + x0]
+                    + src.texels[(size_t)y1 * src.width + x1]);
+            }
+        mips.push_back(std::move(dst));
+    }
+}
+
+// bilinear, GL_REPEAT
+glm::vec4 SplatRenderer::sample(const MipLevel& m, float u, float v) const {
+    float x = u * m.width - 0.5f, y = v * m.height - 0.5f;
+    float fx = std::floor(x), fy = std::floor(y);
+    float tx = x - fx, ty = y - fy;
+    int x0 = (int)fx % m.width, y0 = (int)fy % m.height;
+    if (x0 < 0) x0 += m.width;
+    if (y0 < 0) y0 += m.height;
+    int x1 = x0 + 1 == m.width ? 0 : x0 + 1;
+    int y1 = y0 + 1 == m.height ? 0 : y0 + 1;
+    const glm::vec4* row0 = &m.texels[(size_t)y0 * m.width];
+    const glm::vec4* row1 = &m.texels[(size_t)y1 * m.width];
+    return glm::mix(glm::mix(row0[x0], row0[x1], tx), glm::mix(row1[x0], row1[x1], tx), ty);
+}
+
+void SplatRenderer::render(const GPUParticle* particles, int count, const SplatCamera& cam, SplatImage& image) {
+    image.width = cam.width;
+    image.height = cam.height;
+    image.pixels.resize((size_t)cam.width * cam.height);
+    lastStats = SplatStats();
+    const int tilesX = (cam.width + tileSize - 1) / tileSize;
+    const int tilesY = (cam.height + tileSize - 1) / tileSize;
+    const int tiles = tilesX * tilesY;
+    lastStats.tiles = tiles;
+    if (mips.empty()) {
+        std::fill(image.pixels.begin(), image.pixels.end(), clearColor);
+        return;
+    }
+
+    // 1) project: every billboard becomes a screen rectangle
+    splats.resize(count);
+    visible.resize(count);
+    const float halfW = cam.width * 0.5f, halfH = cam.height * 0.5f;
+    const int levels = (int)mips.size();
+    const float texW = (float)mips[0].width, texH = (float)mips[0].height;
+    auto project = [&](int begin, int end) {
+        for (int i = begin; i < end; ++i) {
+            const GPUParticle& p = particles[i];
+            visible[i] = 0;
+            float alpha = 1.0f - p.life;
+            if (alpha < 0.01f) continue; // discarded by billboard.frag whatever the texel
+            glm::vec4 v = cam.view * glm::vec4(p.px, p.py, p.pz, 1.0f);
+            if (-v.z < cam.nearPlane) continue;
+            glm::vec4 clip = cam.projection * v;
+            float cx = (clip.x / clip.w + 1.0f) * halfW, cy = (clip.y / clip.w + 1.0f) * halfH;
+            float sx = p.size * cam.projection[0][0] / clip.w * halfW;
+            float sy = p.size * cam.projection[1][1] / clip.w * halfH;
+            Splat& s = splats[i];
+            s.x0 = cx - sx;
+            s.x1 = cx + sx;
+            s.y0 = cy - sy;
+            s.y1 = cy + sy;
+            if (s.x1 <= 0.0f || s.y1 <= 0.0f || s.x0 >= cam.width || s.y0 >= cam.height || sx <= 0.0f || sy <= 0.0f) continue;
+            s.du = 0.5f / sx;
+            s.dv = 0.5f / sy;
+            s.alpha = alpha;
+            // nearest mip for the texel footprint of one pixel
+            float rho = std::max(texW * s.du, texH * s.dv);
+            s.level = rho <= 1.0f ? 0 : std::min(levels - 1, (int)std::lround(std::log2(rho)));
+            visible[i] = 1;
+        }
+    };
+    const int blocks = (count + SPLAT_BLOCK - 1) / SPLAT_BLOCK;
+    if (pool && blocks > 1) pool->run(blocks, [&](int b) { project(b * SPLAT_BLOCK, std::min(count, (b + 1) * SPLAT_BLOCK)); });
+    else project(0, count);
+
+    // 2) bin: count per tile, prefix sum, then fill in buffer order so every tile blends in draw order
+    auto pixelRange = [](float a, float b, int size, int& lo, int& hi) {
+        lo = std::max(0, (int)std::ceil(a - 0.5f)); // pixel centres inside [a, b)
+        hi = std::min(size, (int)std::ceil(b - 0.5f));
+    };
+    tileStart.assign(tiles + 1, 0);
+    for (int pass = 0; pass < 2; ++pass) {
+        if (pass == 1) {
+            for (int t = 0; t < tiles; ++t) tileStart[t + 1] += tileStart[t];
+            tileSplats.resize(tileStart[tiles]);
+            tileFill.assign(tileStart.begin(), tileStart.end() - 1);
+        }
+        for (int i = 0; i < count; ++i) {
+            if (!visible[i]) continue;
+            const Splat& s = splats[i];
+            int x0, x1, y0, y1;
+            pixelRange(s.x0, s.x1, cam.width, x0, x1);
+            pixelRange(s.y0, s.y1, cam.height, y0, y1);
+            if (x0 >= x1 || y0 >= y1) continue;
+            for (int ty = y0 / tileSize; ty <= (y1 - 1) / tileSize; ++ty)
+                for (int tx = x0 / tileSize; tx <= (x1 - 1) / tileSize; ++tx) {
+                    int t = ty * tilesX + tx;
+                    if (pass == 0) ++tileStart[t + 1];
+                    else tileSplats[tileFill[t]++] = i;
+                }
+            if (pass == 1) ++lastStats.splats;
+        }
+    }
+    lastStats.binned = tileStart[tiles];
+
+    // 3) blend: tiles own disjoint pixels
+    if (pool) pool->run(tiles, [&](int t) { rasterTile(t, tilesX, cam, image); });
+    else for (int t = 0; t < tiles; ++t) rasterTile(t, tilesX, cam, image);
+}
+
+void SplatRenderer::rasterTile(int tile, int tilesX, const SplatCamera& cam, SplatImage& image) const {
+    const int tx0 = (tile % tilesX) * tileSize, ty0 = (tile / tilesX) * tileSize;
+    const int tx1 = std::min(cam.width, tx0 + tileSize), ty1 = std::min(cam.height, ty0 + tileSize);
+    for (int y = ty0; y < ty1; ++y)
+        std::fill(&image.pixels[(size_t)y * cam.width + tx0], &image.pixels[(size_t)y * cam.width + tx1], clearColor);
+
+    const glm::vec3 tinted = glm::mix(glm::vec3(1.0f), tint, 0.2f);
+    for (int k = tileStart[tile]; k < tileStart[tile + 1]; ++k) {
+        const Splat& s = splats[tileSplats[k]];
+        const MipLevel& m = mips[s.level];
+        int x0 = std::max(tx0, (int)std::ceil(s.x0 - 0.5f)), x1 = std::min(tx1, (int)std::ceil(s.x1 - 0.5f));
+        int y0 = std::max(ty0, (int)std::ceil(s.y0 - 0.5f)), y1 = std::min(ty1, (int)std::ceil(s.y1 - 0.5f));
+        for (int y = y0; y < y1; ++y) {
+            float v = (y + 0.5f - s.y0) * s.dv;
+            glm::vec4* row = &image.pixels[(size_t)y * cam.width];
+            for (int x = x0; x < x1; ++x) {
+                glm::vec4 t = sample(m, (x + 0.5f - s.x0) * s.du, v);
+                float a = t.a * s.alpha;
+                if (a < 0.01f) continue;
+                glm::vec4& d = row[x];
+                glm::vec3 c = tinted * glm::vec3(t);
+                d = glm::vec4(c * a + glm::vec3(d) * (1.0f - a), a * a + d.a * (1.0f - a));
+            }
+        }
+    }
+}
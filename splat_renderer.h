@@ -0,0 +1,92 @@
+#ifndef SPLAT_RENDERER_H
+#define SPLAT_RENDERER_H
+
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "particles.h"
+
+class ThreadPool;
+
+// what the particles are seen through; right / up are the billboard axes
+// (the camera's own, as the viewer passes them to billboard.geom)
+struct SplatCamera {
+    glm::mat4 view = glm::mat4(1.0f);
+    glm::mat4 projection = glm::mat4(1.0f);
+    glm::vec3 right = glm::vec3(1.0f, 0.0f, 0.0f);
+    glm::vec3 up = glm::vec3(0.0f, 1.0f, 0.0f);
+    int width = 0, height = 0;
+    float nearPlane = 0.1f;
+};
+
+// float RGBA framebuffer, bottom row first like GL
+struct SplatImage {
+    int width = 0, height = 0;
+    std::vector<glm::vec4> pixels;
+
+    // clamped to 8 bits, same row order
+    void toRgba8(std::vector<unsigned char>& out) const;
+};
+
+struct SplatStats {
+    int splats = 0;   // particles that landed on screen
+    int binned = 0;   // (particle, tile) pairs
+    int tiles = 0;
+};
+
+// ---------- CPU splatting renderer ----------
+// GPU-free reference for the smoke pass. Billboards face the camera, so each
+// one projects to an axis-aligned screen rectangle with linear UVs; it is
+// shaded with the billboard.frag rule (texture alpha * (1 - life), tinted,
+// SRC_ALPHA / ONE_MINUS_SRC_ALPHA blending in buffer order) from a mip chain
+// of the smoke texture. Particles are projected in parallel, binned to
+// screen tiles once per frame, and the tiles are then blended in parallel,
+// each touching only its own pixels. Only the smoke is drawn, over
+// clearColor; there is no scene geometry to occlude it.
+class SplatRenderer {
+public:
+    glm::vec3 tint = glm::vec3(0.95f, 0.95f, 1.0f);          // SceneRenderer's smoke tint
+    glm::vec4 clearColor = glm::vec4(0.55f, 0.75f, 0.95f, 1.0f); // its sky
+
+    explicit SplatRenderer(int tileSize = 32) : tileSize(tileSize < 4 ? 4 : tileSize) {}
+
+    // parallel projection and tiles (nullptr = serial)
+    void setThreadPool(ThreadPool* p) { pool = p; }
+
+    // smoke.png, flipped like the GL upload; false if it can't be read
+    bool loadTexture(const std::string& path);
+    // RGBA8 rows, bottom row first
+    void setTexture(int width, int height, const unsigned char* rgba);
+
+    void render(const GPUParticle* particles, int count, const SplatCamera& camera, SplatImage& image);
+
+    const SplatStats& stats() const { return lastStats; }
+
+private:
+    struct MipLevel {
+        int width, height;
+        std::vector<glm::vec4> texels;
+    };
+
+    // one projected billboard: pixel-space rectangle, UV step per pixel, mip level
+    struct Splat {
+        float x0, y0, x1, y1;
+        float du, dv;
+        float alpha;   // 1 - life
+        int level;
+    };
+
+    int tileSize;
+    ThreadPool* pool = nullptr;
+    std::vector<MipLevel> mips;
+    std::vector<Splat> splats;
+    std::vector<uint8_t> visible;
+    std::vector<int> tileStart, tileFill, tileSplats;
+    SplatStats lastStats;
+
+    glm::vec4 sample(const MipLevel& m, float u, float v) const;
+    void rasterTile(int tile, int tilesX, const SplatCamera& camera, SplatImage& image) const;
+};
+
+#endif // SPLAT_RENDERER_H
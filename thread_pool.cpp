@@ -0,0 +1,63 @@
+#include "thread_pool.h"
+#include "alloc_tracker.h"
+#include "profiler.h"
+
+ThreadPool::ThreadPool(int threads) {
+    if (threads <= 0) threads = (int)std::thread::hardware_concurrency();
+    for (int i = 1; i < threads; ++i)
+        workers.emplace_back(&ThreadPool::workerLoop, this);
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        quit = true;
+    }
+    wake.notify_all();
+    for (std::thread& t : workers) t.join();
+}
+
+void ThreadPool::dispatch(int tasks, void (*fn)(void*, int), void* ctx) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobFn = fn;
+        jobCtx = ctx;
+        jobTasks = tasks;
+        nextTask.store(0, std::memory_order_relaxed);
+        pending.store(tasks, std::memory_order_relaxed);
+        ++generation;
+    }
+    wake.notify_all();
+    work();
+    // every task done and no worker still looking at this job's fields
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [this] { return pending.load(std::memory_order_acquire) == 0 && busyWorkers == 0; });
+    jobFn = nullptr;
+}
+
+void ThreadPool::work() {
+    for (;;) {
+        int t = nextTask.fetch_add(1, std::memory_order_relaxed);
+        if (t >= jobTasks) return;
+        jobFn(jobCtx, t);
+        pending.fetch_sub(1, std::memory_order_acq_rel);
+    }
+}
+
+void ThreadPool::workerLoop() {
+    CpuProfiler::setThreadName("pool worker");
+    AllocTracker::setThreadName("pool worker");
+    uint64_t seen = 0;
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;) {
+        wake.wait(lock, [&] { return quit || (generation != seen && jobFn); });
+        if (quit) return;
+        seen = generation;
+        ++busyWorkers;
+        lock.unlock();
+        work();
+        lock.lock();
+        --busyWorkers;
+        if (busyWorkers == 0) done.notify_all();
+    }
+}
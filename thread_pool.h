@@ -0,0 +1,60 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// ---------- Thread pool ----------
+// Fixed set of worker threads for data-parallel loops. run() hands out task
+// indices [0, tasks) through an atomic counter, the calling thread works on
+// them too, and it returns once every task has finished. The callable is
+// passed by pointer, so dispatching a loop allocates nothing.
+class ThreadPool {
+public:
+    // threads = total threads including the caller; 0 = one per hardware thread
+    explicit ThreadPool(int threads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    int size() const { return (int)workers.size() + 1; }
+
+    // calls fn(task) for every task in [0, tasks); one run() at a time
+    template <typename F>
+    void run(int tasks, F&& fn) {
+        if (tasks <= 0) return;
+        if (tasks == 1 || workers.empty()) {
+            for (int t = 0; t < tasks; ++t) fn(t);
+            return;
+        }
+        using Fn = typename std::remove_reference<F>::type;
+        dispatch(tasks, [](void* ctx, int t) { (*(Fn*)ctx)(t); }, (void*)&fn);
+    }
+
+private:
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake, done;
+    bool quit = false;
+    uint64_t generation = 0;
+
+    // current job
+    void (*jobFn)(void*, int) = nullptr;
+    void* jobCtx = nullptr;
+    int jobTasks = 0;
+    std::atomic<int> nextTask{ 0 };
+    std::atomic<int> pending{ 0 };
+    int busyWorkers = 0;
+
+    void dispatch(int tasks, void (*fn)(void*, int), void* ctx);
+    void work();
+    void workerLoop();
+};
+
+#endif // THREAD_POOL_H
@@ -0,0 +1,55 @@
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+#include <atomic>
+#include <cstdint>
+
+// ---------- Lock-free triple buffer ----------
+// One producer thread, one consumer thread, three slots. The producer fills
+// its back slot and publishes it by swapping it with the shared middle slot;
+// the consumer swaps the middle slot with its front slot whenever something
+// new was published. Neither side ever waits for the other: a producer that
+// runs ahead overwrites snapshots the consumer never saw (dropped), and a
+// consumer that runs ahead gets the previous one again (duplicated).
+template <typename T>
+class TripleBuffer {
+public:
+    explicit TripleBuffer(const T& init = T()) : slots{ { init }, { init }, { init } } {}
+
+    // producer: the slot to fill; stays valid until publish()
+    T& writeBuffer() { return slots[back].value; }
+
+    // producer: makes the filled slot the newest one
+    void publish() {
+        uint8_t old = middle.exchange((uint8_t)(back | FRESH), std::memory_order_acq_rel);
+        if (old & FRESH) dropped.fetch_add(1, std::memory_order_relaxed);
+        back = old & INDEX;
+    }
+
+    // consumer: the newest published slot; stays valid until the next read()
+    const T& read(bool* fresh = nullptr) {
+        bool isNew = (middle.load(std::memory_order_relaxed) & FRESH) != 0;
+        if (isNew) front = middle.exchange(front, std::memory_order_acq_rel) & INDEX;
+        else duplicated.fetch_add(1, std::memory_order_relaxed);
+        if (fresh) *fresh = isNew;
+        return slots[front].value;
+    }
+
+    uint64_t droppedCount() const { return dropped.load(std::memory_order_relaxed); }
+    uint64_t duplicatedCount() const { return duplicated.load(std::memory_order_relaxed); }
+
+private:
+    static const uint8_t INDEX = 3;
+    static const uint8_t FRESH = 4;
+
+    // each side's slot and counter on its own cache line so they don't false-share
+    struct alignas(64) Slot { T value; };
+    Slot slots[3];
+    alignas(64) std::atomic<uint8_t> middle{ 1 };
+    alignas(64) uint8_t back = 0;
+    std::atomic<uint64_t> dropped{ 0 };
+    alignas(64) uint8_t front = 2;
+    std::atomic<uint64_t> duplicated{ 0 };
+};
+
+#endif // TRIPLE_BUFFER_H
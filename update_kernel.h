@@ -0,0 +1,88 @@
+#ifndef UPDATE_KERNEL_H
+#define UPDATE_KERNEL_H
+
+#include <glm/glm.hpp>
+#include "noise.h"
+#include "particles.h"
+
+// ---------- Update kernels ----------
+// An emitter's motion is a list of force policies fused into one loop at
+// compile time: UpdateKernel<Forces...>::apply() runs every policy's apply()
+// in list order, all inlined, then integrates the position. ParticleSystem
+// picks one instantiation per emitter and run from its EmitterMotion, so
+// the inner loop has no dispatch and no branches on the configuration.
+// A policy is a struct with
+//   static void apply(Particle& p, const ForceStep& s, KernelContext& c);
+// Velocity is integrated after the last policy, so damping goes last among
+// the ones that change it.
+
+// per emitter and run, hoisted out of the loop
+struct KernelContext {
+    float time;
+    glm::vec2 origin;       // emitter axis in xz
+    float horizontalSpread;
+    float sizeBase, sizeGrowth; // sizeGrowth - 1
+    NoiseCache noise;       // Flow<true> only
+};
+
+// per particle
+struct ForceStep {
+    float step;     // seconds, including time skipped by sim LOD
+    float hFactor;  // rise over spreadHeight, 0..1
+    float damping;  // velocity factor for this step
+};
+
+// natural upward drift
+struct Drift {
+    static constexpr float LIFT = 0.5f;
+    static void apply(Particle& p, const ForceStep& s, KernelContext&) {
+        p.vel += glm::vec3(0.0f, LIFT * s.step, 0.0f);
+    }
+};
+
+// smooth turbulent motion from the Perlin flow, growing with height;
+// CachedNoise reuses lattice cells between neighbours (spatially ordered slices only)
+template <bool CachedNoise>
+struct Flow {
+    static constexpr float BASE = 0.4f, HEIGHT_GAIN = 1.6f;
+    static void apply(Particle& p, const ForceStep& s, KernelContext& c) {
+        glm::vec3 flow = CachedNoise ? noiseVelocity(p.pos, c.time, c.noise) : noiseVelocity(p.pos, c.time);
+        p.vel += flow * s.step * (BASE + HEIGHT_GAIN * s.hFactor);
+    }
+};
+
+// gradual horizontal expansion away from the emitter axis
+struct Spread {
+    static void apply(Particle& p, const ForceStep& s, KernelContext& c) {
+        glm::vec2 radialDir = glm::normalize(glm::vec2(p.pos.x - c.origin.x + 1e-6f, p.pos.z - c.origin.y + 1e-6f));
+        p.vel += glm::vec3(radialDir.x, 0.0f, radialDir.y) * (c.horizontalSpread * s.step * s.hFactor);
+    }
+};
+
+struct Damping {
+    static void apply(Particle& p, const ForceStep& s, KernelContext&) { p.vel *= s.damping; }
+};
+
+// puffs grow as they rise; without it they keep their spawn size
+struct GrowWithHeight {
+    static void apply(Particle& p, const ForceStep& s, KernelContext& c) {
+        p.size = c.sizeBase * (1.0f + c.sizeGrowth * s.hFactor);
+    }
+};
+
+template <class... Forces>
+struct UpdateKernel {
+    static void apply(Particle& p, const ForceStep& s, KernelContext& c) {
+        (Forces::apply(p, s, c), ...);
+        p.pos += p.vel * s.step;
+    }
+};
+
+// ---------- Pre-instantiated motions ----------
+// one per EmitterMotion; the plume has a variant for Morton-ordered slices
+template <bool CachedNoise>
+using PlumeKernel = UpdateKernel<Drift, Flow<CachedNoise>, Spread, Damping, GrowWithHeight>;
+using CalmKernel = UpdateKernel<Drift, Spread, Damping, GrowWithHeight>;
+using JetKernel = UpdateKernel<Drift, Damping>;
+
+#endif // UPDATE_KERNEL_H
@@ -0,0 +1,41 @@
+#version 450 core
+// volume smoke, pass 3: one ray per pixel through the density box, a fixed
+// number of steps, front to back with early exit; premultiplied output for
+// blending ONE, ONE_MINUS_SRC_ALPHA over the scene
+out vec4 FragColor;
+
+uniform sampler3D extinction; // per world unit
+uniform mat4 invViewProj;
+uniform vec3 camPos;
+uniform vec3 boxMin, boxMax;  // part of the volume in use
+uniform vec3 volumeScale;     // world -> texture coordinates: (p - boxMin) * volumeScale
+uniform int steps;
+uniform vec3 color;
+uniform ivec2 viewportOrigin;
+uniform ivec2 viewportSize;
+
+void main() {
+    vec2 ndc = (gl_FragCoord.xy - vec2(viewportOrigin)) / vec2(viewportSize) * 2.0 - 1.0;
+    vec4 far = invViewProj * vec4(ndc, 1.0, 1.0);
+    vec3 dir = normalize(far.xyz / far.w - camPos);
+
+    // slab test against the box
+    vec3 inv = 1.0 / dir;
+    vec3 ta = (boxMin - camPos) * inv, tb = (boxMax - camPos) * inv;
+    float t0 = max(max(min(ta.x, tb.x), min(ta.y, tb.y)), max(min(ta.z, tb.z), 0.0));
+    float t1 = min(min(max(ta.x, tb.x), max(ta.y, tb.y)), max(ta.z, tb.z));
+    if (t1 <= t0) discard;
+
+    float dt = (t1 - t0) / float(steps);
+    // interleaved gradient noise offsets the first sample to turn banding into fine grain
+    float jitter = fract(52.9829189 * fract(dot(gl_FragCoord.xy, vec2(0.06711056, 0.00583715))));
+    float transmittance = 1.0;
+    for (int i = 0; i < steps && transmittance > 0.004; ++i) {
+        vec3 p = camPos + dir * (t0 + (float(i) + jitter) * dt);
+        float sigma = texture(extinction, (p - boxMin) * volumeScale).r;
+        transmittance *= exp(-sigma * dt);
+    }
+    float alpha = 1.0 - transmittance;
+    if (alpha < 0.004) discard;
+    FragColor = vec4(color * alpha, alpha);
+}